@@ -0,0 +1,335 @@
+/*
+ *************************************************************************************
+ * ADC CODE <-> DISTANCE TABLES
+ *
+ * GENERATED BY tools/gen_adc_table.c - DO NOT EDIT
+ *
+ * distance [mm] = 532480 / (3 * code) - 10, clamped to 0..800 [mm]
+ *************************************************************************************
+ */
+#ifndef ADC_DISTANCE_TABLE_H
+#define ADC_DISTANCE_TABLE_H
+
+#include <stdint.h>
+
+#define ADC_TABLE_MAX_MM    800
+
+// Compile-time conversion for thresholds, rounded to the nearest code
+#define MM_TO_ADC(mm)       ((1064960 / (3 * ((mm) + 10)) + 1) / 2)
+
+// ADC code -> distance [mm]
+static const uint16_t adcToMM[4096] = {
+    800, 800, 800, 800, 800, 800, 800, 800, 800, 800, 800, 800, 800, 800, 800, 800,
+    800, 800, 800, 800, 800, 800, 800, 800, 800, 800, 800, 800, 800, 800, 800, 800,
+    800, 800, 800, 800, 800, 800, 800, 800, 800, 800, 800, 800, 800, 800, 800, 800,
+    800, 800, 800, 800, 800, 800, 800, 800, 800, 800, 800, 800, 800, 800, 800, 800,
+    800, 800, 800, 800, 800, 800, 800, 800, 800, 800, 800, 800, 800, 800, 800, 800,
+    800, 800, 800, 800, 800, 800, 800, 800, 800, 800, 800, 800, 800, 800, 800, 800,
+    800, 800, 800, 800, 800, 800, 800, 800, 800, 800, 800, 800, 800, 800, 800, 800,
+    800, 800, 800, 800, 800, 800, 800, 800, 800, 800, 800, 800, 800, 800, 800, 800,
+    800, 800, 800, 800, 800, 800, 800, 800, 800, 800, 800, 800, 800, 800, 800, 800,
+    800, 800, 800, 800, 800, 800, 800, 800, 800, 800, 800, 800, 800, 800, 800, 800,
+    800, 800, 800, 800, 800, 800, 800, 800, 800, 800, 800, 800, 800, 800, 800, 800,
+    800, 800, 800, 800, 800, 800, 800, 800, 800, 800, 800, 800, 800, 800, 800, 800,
+    800, 800, 800, 800, 800, 800, 800, 800, 800, 800, 800, 800, 800, 800, 800, 800,
+    800, 800, 800, 800, 800, 800, 800, 800, 800, 800, 800, 800, 797, 793, 790, 786,
+    782, 779, 775, 772, 768, 765, 762, 758, 755, 752, 749, 745, 742, 739, 736, 733,
+    730, 726, 723, 720, 717, 714, 712, 709, 706, 703, 700, 697, 694, 692, 689, 686,
+    683, 681, 678, 675, 673, 670, 667, 665, 662, 660, 657, 655, 652, 650, 647, 645,
+    643, 640, 638, 635, 633, 631, 628, 626, 624, 622, 619, 617, 615, 613, 611, 608,
+    606, 604, 602, 600, 598, 596, 594, 592, 590, 588, 586, 584, 582, 580, 578, 576,
+    574, 572, 570, 568, 566, 564, 563, 561, 559, 557, 555, 553, 552, 550, 548, 546,
+    545, 543, 541, 540, 538, 536, 534, 533, 531, 529, 528, 526, 525, 523, 521, 520,
+    518, 517, 515, 514, 512, 511, 509, 507, 506, 504, 503, 502, 500, 499, 497, 496,
+    494, 493, 491, 490, 489, 487, 486, 484, 483, 482, 480, 479, 478, 476, 475, 474,
+    472, 471, 470, 468, 467, 466, 465, 463, 462, 461, 460, 458, 457, 456, 455, 453,
+    452, 451, 450, 449, 447, 446, 445, 444, 443, 442, 440, 439, 438, 437, 436, 435,
+    434, 433, 432, 430, 429, 428, 427, 426, 425, 424, 423, 422, 421, 420, 419, 418,
+    417, 416, 415, 414, 413, 412, 411, 410, 409, 408, 407, 406, 405, 404, 403, 402,
+    401, 400, 399, 398, 397, 396, 395, 394, 393, 392, 392, 391, 390, 389, 388, 387,
+    386, 385, 384, 384, 383, 382, 381, 380, 379, 378, 378, 377, 376, 375, 374, 373,
+    373, 372, 371, 370, 369, 368, 368, 367, 366, 365, 364, 364, 363, 362, 361, 361,
+    360, 359, 358, 357, 357, 356, 355, 354, 354, 353, 352, 351, 351, 350, 349, 349,
+    348, 347, 346, 346, 345, 344, 344, 343, 342, 341, 341, 340, 339, 339, 338, 337,
+    337, 336, 335, 335, 334, 333, 333, 332, 331, 331, 330, 329, 329, 328, 327, 327,
+    326, 326, 325, 324, 324, 323, 322, 322, 321, 321, 320, 319, 319, 318, 317, 317,
+    316, 316, 315, 314, 314, 313, 313, 312, 312, 311, 310, 310, 309, 309, 308, 308,
+    307, 306, 306, 305, 305, 304, 304, 303, 302, 302, 301, 301, 300, 300, 299, 299,
+    298, 298, 297, 297, 296, 295, 295, 294, 294, 293, 293, 292, 292, 291, 291, 290,
+    290, 289, 289, 288, 288, 287, 287, 286, 286, 285, 285, 284, 284, 283, 283, 282,
+    282, 281, 281, 280, 280, 280, 279, 279, 278, 278, 277, 277, 276, 276, 275, 275,
+    274, 274, 274, 273, 273, 272, 272, 271, 271, 270, 270, 270, 269, 269, 268, 268,
+    267, 267, 266, 266, 266, 265, 265, 264, 264, 263, 263, 263, 262, 262, 261, 261,
+    261, 260, 260, 259, 259, 259, 258, 258, 257, 257, 257, 256, 256, 255, 255, 255,
+    254, 254, 253, 253, 253, 252, 252, 251, 251, 251, 250, 250, 249, 249, 249, 248,
+    248, 248, 247, 247, 246, 246, 246, 245, 245, 245, 244, 244, 244, 243, 243, 242,
+    242, 242, 241, 241, 241, 240, 240, 240, 239, 239, 239, 238, 238, 238, 237, 237,
+    237, 236, 236, 235, 235, 235, 234, 234, 234, 233, 233, 233, 232, 232, 232, 231,
+    231, 231, 231, 230, 230, 230, 229, 229, 229, 228, 228, 228, 227, 227, 227, 226,
+    226, 226, 225, 225, 225, 224, 224, 224, 224, 223, 223, 223, 222, 222, 222, 221,
+    221, 221, 221, 220, 220, 220, 219, 219, 219, 218, 218, 218, 218, 217, 217, 217,
+    216, 216, 216, 216, 215, 215, 215, 214, 214, 214, 214, 213, 213, 213, 212, 212,
+    212, 212, 211, 211, 211, 210, 210, 210, 210, 209, 209, 209, 209, 208, 208, 208,
+    208, 207, 207, 207, 206, 206, 206, 206, 205, 205, 205, 205, 204, 204, 204, 204,
+    203, 203, 203, 203, 202, 202, 202, 202, 201, 201, 201, 201, 200, 200, 200, 200,
+    199, 199, 199, 199, 198, 198, 198, 198, 197, 197, 197, 197, 196, 196, 196, 196,
+    195, 195, 195, 195, 194, 194, 194, 194, 194, 193, 193, 193, 193, 192, 192, 192,
+    192, 191, 191, 191, 191, 191, 190, 190, 190, 190, 189, 189, 189, 189, 189, 188,
+    188, 188, 188, 187, 187, 187, 187, 187, 186, 186, 186, 186, 185, 185, 185, 185,
+    185, 184, 184, 184, 184, 184, 183, 183, 183, 183, 183, 182, 182, 182, 182, 181,
+    181, 181, 181, 181, 180, 180, 180, 180, 180, 179, 179, 179, 179, 179, 178, 178,
+    178, 178, 178, 177, 177, 177, 177, 177, 176, 176, 176, 176, 176, 175, 175, 175,
+    175, 175, 175, 174, 174, 174, 174, 174, 173, 173, 173, 173, 173, 172, 172, 172,
+    172, 172, 171, 171, 171, 171, 171, 171, 170, 170, 170, 170, 170, 169, 169, 169,
+    169, 169, 169, 168, 168, 168, 168, 168, 167, 167, 167, 167, 167, 167, 166, 166,
+    166, 166, 166, 166, 165, 165, 165, 165, 165, 165, 164, 164, 164, 164, 164, 164,
+    163, 163, 163, 163, 163, 162, 162, 162, 162, 162, 162, 161, 161, 161, 161, 161,
+    161, 161, 160, 160, 160, 160, 160, 160, 159, 159, 159, 159, 159, 159, 158, 158,
+    158, 158, 158, 158, 157, 157, 157, 157, 157, 157, 157, 156, 156, 156, 156, 156,
+    156, 155, 155, 155, 155, 155, 155, 154, 154, 154, 154, 154, 154, 154, 153, 153,
+    153, 153, 153, 153, 153, 152, 152, 152, 152, 152, 152, 152, 151, 151, 151, 151,
+    151, 151, 150, 150, 150, 150, 150, 150, 150, 149, 149, 149, 149, 149, 149, 149,
+    148, 148, 148, 148, 148, 148, 148, 147, 147, 147, 147, 147, 147, 147, 147, 146,
+    146, 146, 146, 146, 146, 146, 145, 145, 145, 145, 145, 145, 145, 144, 144, 144,
+    144, 144, 144, 144, 144, 143, 143, 143, 143, 143, 143, 143, 142, 142, 142, 142,
+    142, 142, 142, 142, 141, 141, 141, 141, 141, 141, 141, 141, 140, 140, 140, 140,
+    140, 140, 140, 140, 139, 139, 139, 139, 139, 139, 139, 139, 138, 138, 138, 138,
+    138, 138, 138, 138, 137, 137, 137, 137, 137, 137, 137, 137, 136, 136, 136, 136,
+    136, 136, 136, 136, 135, 135, 135, 135, 135, 135, 135, 135, 135, 134, 134, 134,
+    134, 134, 134, 134, 134, 133, 133, 133, 133, 133, 133, 133, 133, 133, 132, 132,
+    132, 132, 132, 132, 132, 132, 132, 131, 131, 131, 131, 131, 131, 131, 131, 131,
+    130, 130, 130, 130, 130, 130, 130, 130, 130, 129, 129, 129, 129, 129, 129, 129,
+    129, 129, 128, 128, 128, 128, 128, 128, 128, 128, 128, 127, 127, 127, 127, 127,
+    127, 127, 127, 127, 127, 126, 126, 126, 126, 126, 126, 126, 126, 126, 125, 125,
+    125, 125, 125, 125, 125, 125, 125, 125, 124, 124, 124, 124, 124, 124, 124, 124,
+    124, 124, 123, 123, 123, 123, 123, 123, 123, 123, 123, 123, 122, 122, 122, 122,
+    122, 122, 122, 122, 122, 122, 121, 121, 121, 121, 121, 121, 121, 121, 121, 121,
+    121, 120, 120, 120, 120, 120, 120, 120, 120, 120, 120, 119, 119, 119, 119, 119,
+    119, 119, 119, 119, 119, 119, 118, 118, 118, 118, 118, 118, 118, 118, 118, 118,
+    118, 117, 117, 117, 117, 117, 117, 117, 117, 117, 117, 117, 116, 116, 116, 116,
+    116, 116, 116, 116, 116, 116, 116, 115, 115, 115, 115, 115, 115, 115, 115, 115,
+    115, 115, 114, 114, 114, 114, 114, 114, 114, 114, 114, 114, 114, 114, 113, 113,
+    113, 113, 113, 113, 113, 113, 113, 113, 113, 112, 112, 112, 112, 112, 112, 112,
+    112, 112, 112, 112, 112, 111, 111, 111, 111, 111, 111, 111, 111, 111, 111, 111,
+    111, 110, 110, 110, 110, 110, 110, 110, 110, 110, 110, 110, 110, 110, 109, 109,
+    109, 109, 109, 109, 109, 109, 109, 109, 109, 109, 108, 108, 108, 108, 108, 108,
+    108, 108, 108, 108, 108, 108, 108, 107, 107, 107, 107, 107, 107, 107, 107, 107,
+    107, 107, 107, 107, 106, 106, 106, 106, 106, 106, 106, 106, 106, 106, 106, 106,
+    106, 105, 105, 105, 105, 105, 105, 105, 105, 105, 105, 105, 105, 105, 105, 104,
+    104, 104, 104, 104, 104, 104, 104, 104, 104, 104, 104, 104, 103, 103, 103, 103,
+    103, 103, 103, 103, 103, 103, 103, 103, 103, 103, 102, 102, 102, 102, 102, 102,
+    102, 102, 102, 102, 102, 102, 102, 102, 101, 101, 101, 101, 101, 101, 101, 101,
+    101, 101, 101, 101, 101, 101, 101, 100, 100, 100, 100, 100, 100, 100, 100, 100,
+    100, 100, 100, 100, 100, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99,
+    99, 99, 99, 99, 98, 98, 98, 98, 98, 98, 98, 98, 98, 98, 98, 98,
+    98, 98, 98, 98, 97, 97, 97, 97, 97, 97, 97, 97, 97, 97, 97, 97,
+    97, 97, 97, 96, 96, 96, 96, 96, 96, 96, 96, 96, 96, 96, 96, 96,
+    96, 96, 96, 95, 95, 95, 95, 95, 95, 95, 95, 95, 95, 95, 95, 95,
+    95, 95, 95, 94, 94, 94, 94, 94, 94, 94, 94, 94, 94, 94, 94, 94,
+    94, 94, 94, 93, 93, 93, 93, 93, 93, 93, 93, 93, 93, 93, 93, 93,
+    93, 93, 93, 93, 92, 92, 92, 92, 92, 92, 92, 92, 92, 92, 92, 92,
+    92, 92, 92, 92, 92, 91, 91, 91, 91, 91, 91, 91, 91, 91, 91, 91,
+    91, 91, 91, 91, 91, 91, 91, 90, 90, 90, 90, 90, 90, 90, 90, 90,
+    90, 90, 90, 90, 90, 90, 90, 90, 89, 89, 89, 89, 89, 89, 89, 89,
+    89, 89, 89, 89, 89, 89, 89, 89, 89, 89, 88, 88, 88, 88, 88, 88,
+    88, 88, 88, 88, 88, 88, 88, 88, 88, 88, 88, 88, 88, 87, 87, 87,
+    87, 87, 87, 87, 87, 87, 87, 87, 87, 87, 87, 87, 87, 87, 87, 87,
+    86, 86, 86, 86, 86, 86, 86, 86, 86, 86, 86, 86, 86, 86, 86, 86,
+    86, 86, 86, 85, 85, 85, 85, 85, 85, 85, 85, 85, 85, 85, 85, 85,
+    85, 85, 85, 85, 85, 85, 85, 84, 84, 84, 84, 84, 84, 84, 84, 84,
+    84, 84, 84, 84, 84, 84, 84, 84, 84, 84, 84, 83, 83, 83, 83, 83,
+    83, 83, 83, 83, 83, 83, 83, 83, 83, 83, 83, 83, 83, 83, 83, 82,
+    82, 82, 82, 82, 82, 82, 82, 82, 82, 82, 82, 82, 82, 82, 82, 82,
+    82, 82, 82, 82, 81, 81, 81, 81, 81, 81, 81, 81, 81, 81, 81, 81,
+    81, 81, 81, 81, 81, 81, 81, 81, 81, 81, 80, 80, 80, 80, 80, 80,
+    80, 80, 80, 80, 80, 80, 80, 80, 80, 80, 80, 80, 80, 80, 80, 80,
+    79, 79, 79, 79, 79, 79, 79, 79, 79, 79, 79, 79, 79, 79, 79, 79,
+    79, 79, 79, 79, 79, 79, 78, 78, 78, 78, 78, 78, 78, 78, 78, 78,
+    78, 78, 78, 78, 78, 78, 78, 78, 78, 78, 78, 78, 78, 77, 77, 77,
+    77, 77, 77, 77, 77, 77, 77, 77, 77, 77, 77, 77, 77, 77, 77, 77,
+    77, 77, 77, 77, 76, 76, 76, 76, 76, 76, 76, 76, 76, 76, 76, 76,
+    76, 76, 76, 76, 76, 76, 76, 76, 76, 76, 76, 76, 75, 75, 75, 75,
+    75, 75, 75, 75, 75, 75, 75, 75, 75, 75, 75, 75, 75, 75, 75, 75,
+    75, 75, 75, 75, 75, 74, 74, 74, 74, 74, 74, 74, 74, 74, 74, 74,
+    74, 74, 74, 74, 74, 74, 74, 74, 74, 74, 74, 74, 74, 74, 73, 73,
+    73, 73, 73, 73, 73, 73, 73, 73, 73, 73, 73, 73, 73, 73, 73, 73,
+    73, 73, 73, 73, 73, 73, 73, 73, 72, 72, 72, 72, 72, 72, 72, 72,
+    72, 72, 72, 72, 72, 72, 72, 72, 72, 72, 72, 72, 72, 72, 72, 72,
+    72, 72, 71, 71, 71, 71, 71, 71, 71, 71, 71, 71, 71, 71, 71, 71,
+    71, 71, 71, 71, 71, 71, 71, 71, 71, 71, 71, 71, 71, 70, 70, 70,
+    70, 70, 70, 70, 70, 70, 70, 70, 70, 70, 70, 70, 70, 70, 70, 70,
+    70, 70, 70, 70, 70, 70, 70, 70, 70, 69, 69, 69, 69, 69, 69, 69,
+    69, 69, 69, 69, 69, 69, 69, 69, 69, 69, 69, 69, 69, 69, 69, 69,
+    69, 69, 69, 69, 69, 69, 68, 68, 68, 68, 68, 68, 68, 68, 68, 68,
+    68, 68, 68, 68, 68, 68, 68, 68, 68, 68, 68, 68, 68, 68, 68, 68,
+    68, 68, 68, 67, 67, 67, 67, 67, 67, 67, 67, 67, 67, 67, 67, 67,
+    67, 67, 67, 67, 67, 67, 67, 67, 67, 67, 67, 67, 67, 67, 67, 67,
+    67, 66, 66, 66, 66, 66, 66, 66, 66, 66, 66, 66, 66, 66, 66, 66,
+    66, 66, 66, 66, 66, 66, 66, 66, 66, 66, 66, 66, 66, 66, 66, 65,
+    65, 65, 65, 65, 65, 65, 65, 65, 65, 65, 65, 65, 65, 65, 65, 65,
+    65, 65, 65, 65, 65, 65, 65, 65, 65, 65, 65, 65, 65, 65, 65, 64,
+    64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 64,
+    64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 64, 63,
+    63, 63, 63, 63, 63, 63, 63, 63, 63, 63, 63, 63, 63, 63, 63, 63,
+    63, 63, 63, 63, 63, 63, 63, 63, 63, 63, 63, 63, 63, 63, 63, 63,
+    63, 62, 62, 62, 62, 62, 62, 62, 62, 62, 62, 62, 62, 62, 62, 62,
+    62, 62, 62, 62, 62, 62, 62, 62, 62, 62, 62, 62, 62, 62, 62, 62,
+    62, 62, 62, 61, 61, 61, 61, 61, 61, 61, 61, 61, 61, 61, 61, 61,
+    61, 61, 61, 61, 61, 61, 61, 61, 61, 61, 61, 61, 61, 61, 61, 61,
+    61, 61, 61, 61, 61, 61, 60, 60, 60, 60, 60, 60, 60, 60, 60, 60,
+    60, 60, 60, 60, 60, 60, 60, 60, 60, 60, 60, 60, 60, 60, 60, 60,
+    60, 60, 60, 60, 60, 60, 60, 60, 60, 60, 59, 59, 59, 59, 59, 59,
+    59, 59, 59, 59, 59, 59, 59, 59, 59, 59, 59, 59, 59, 59, 59, 59,
+    59, 59, 59, 59, 59, 59, 59, 59, 59, 59, 59, 59, 59, 59, 59, 59,
+    58, 58, 58, 58, 58, 58, 58, 58, 58, 58, 58, 58, 58, 58, 58, 58,
+    58, 58, 58, 58, 58, 58, 58, 58, 58, 58, 58, 58, 58, 58, 58, 58,
+    58, 58, 58, 58, 58, 58, 57, 57, 57, 57, 57, 57, 57, 57, 57, 57,
+    57, 57, 57, 57, 57, 57, 57, 57, 57, 57, 57, 57, 57, 57, 57, 57,
+    57, 57, 57, 57, 57, 57, 57, 57, 57, 57, 57, 57, 57, 57, 56, 56,
+    56, 56, 56, 56, 56, 56, 56, 56, 56, 56, 56, 56, 56, 56, 56, 56,
+    56, 56, 56, 56, 56, 56, 56, 56, 56, 56, 56, 56, 56, 56, 56, 56,
+    56, 56, 56, 56, 56, 56, 55, 55, 55, 55, 55, 55, 55, 55, 55, 55,
+    55, 55, 55, 55, 55, 55, 55, 55, 55, 55, 55, 55, 55, 55, 55, 55,
+    55, 55, 55, 55, 55, 55, 55, 55, 55, 55, 55, 55, 55, 55, 55, 55,
+    54, 54, 54, 54, 54, 54, 54, 54, 54, 54, 54, 54, 54, 54, 54, 54,
+    54, 54, 54, 54, 54, 54, 54, 54, 54, 54, 54, 54, 54, 54, 54, 54,
+    54, 54, 54, 54, 54, 54, 54, 54, 54, 54, 54, 54, 53, 53, 53, 53,
+    53, 53, 53, 53, 53, 53, 53, 53, 53, 53, 53, 53, 53, 53, 53, 53,
+    53, 53, 53, 53, 53, 53, 53, 53, 53, 53, 53, 53, 53, 53, 53, 53,
+    53, 53, 53, 53, 53, 53, 53, 53, 52, 52, 52, 52, 52, 52, 52, 52,
+    52, 52, 52, 52, 52, 52, 52, 52, 52, 52, 52, 52, 52, 52, 52, 52,
+    52, 52, 52, 52, 52, 52, 52, 52, 52, 52, 52, 52, 52, 52, 52, 52,
+    52, 52, 52, 52, 52, 52, 52, 51, 51, 51, 51, 51, 51, 51, 51, 51,
+    51, 51, 51, 51, 51, 51, 51, 51, 51, 51, 51, 51, 51, 51, 51, 51,
+    51, 51, 51, 51, 51, 51, 51, 51, 51, 51, 51, 51, 51, 51, 51, 51,
+    51, 51, 51, 51, 51, 51, 50, 50, 50, 50, 50, 50, 50, 50, 50, 50,
+    50, 50, 50, 50, 50, 50, 50, 50, 50, 50, 50, 50, 50, 50, 50, 50,
+    50, 50, 50, 50, 50, 50, 50, 50, 50, 50, 50, 50, 50, 50, 50, 50,
+    50, 50, 50, 50, 50, 50, 50, 50, 49, 49, 49, 49, 49, 49, 49, 49,
+    49, 49, 49, 49, 49, 49, 49, 49, 49, 49, 49, 49, 49, 49, 49, 49,
+    49, 49, 49, 49, 49, 49, 49, 49, 49, 49, 49, 49, 49, 49, 49, 49,
+    49, 49, 49, 49, 49, 49, 49, 49, 49, 49, 49, 48, 48, 48, 48, 48,
+    48, 48, 48, 48, 48, 48, 48, 48, 48, 48, 48, 48, 48, 48, 48, 48,
+    48, 48, 48, 48, 48, 48, 48, 48, 48, 48, 48, 48, 48, 48, 48, 48,
+    48, 48, 48, 48, 48, 48, 48, 48, 48, 48, 48, 48, 48, 48, 48, 47,
+    47, 47, 47, 47, 47, 47, 47, 47, 47, 47, 47, 47, 47, 47, 47, 47,
+    47, 47, 47, 47, 47, 47, 47, 47, 47, 47, 47, 47, 47, 47, 47, 47,
+    47, 47, 47, 47, 47, 47, 47, 47, 47, 47, 47, 47, 47, 47, 47, 47,
+    47, 47, 47, 47, 47, 47, 46, 46, 46, 46, 46, 46, 46, 46, 46, 46,
+    46, 46, 46, 46, 46, 46, 46, 46, 46, 46, 46, 46, 46, 46, 46, 46,
+    46, 46, 46, 46, 46, 46, 46, 46, 46, 46, 46, 46, 46, 46, 46, 46,
+    46, 46, 46, 46, 46, 46, 46, 46, 46, 46, 46, 46, 46, 46, 46, 45,
+    45, 45, 45, 45, 45, 45, 45, 45, 45, 45, 45, 45, 45, 45, 45, 45,
+    45, 45, 45, 45, 45, 45, 45, 45, 45, 45, 45, 45, 45, 45, 45, 45,
+    45, 45, 45, 45, 45, 45, 45, 45, 45, 45, 45, 45, 45, 45, 45, 45,
+    45, 45, 45, 45, 45, 45, 45, 45, 45, 44, 44, 44, 44, 44, 44, 44,
+    44, 44, 44, 44, 44, 44, 44, 44, 44, 44, 44, 44, 44, 44, 44, 44,
+    44, 44, 44, 44, 44, 44, 44, 44, 44, 44, 44, 44, 44, 44, 44, 44,
+    44, 44, 44, 44, 44, 44, 44, 44, 44, 44, 44, 44, 44, 44, 44, 44,
+    44, 44, 44, 44, 44, 44, 43, 43, 43, 43, 43, 43, 43, 43, 43, 43,
+    43, 43, 43, 43, 43, 43, 43, 43, 43, 43, 43, 43, 43, 43, 43, 43,
+    43, 43, 43, 43, 43, 43, 43, 43, 43, 43, 43, 43, 43, 43, 43, 43,
+    43, 43, 43, 43, 43, 43, 43, 43, 43, 43, 43, 43, 43, 43, 43, 43,
+    43, 43, 43, 43, 43, 42, 42, 42, 42, 42, 42, 42, 42, 42, 42, 42,
+    42, 42, 42, 42, 42, 42, 42, 42, 42, 42, 42, 42, 42, 42, 42, 42,
+    42, 42, 42, 42, 42, 42, 42, 42, 42, 42, 42, 42, 42, 42, 42, 42,
+    42, 42, 42, 42, 42, 42, 42, 42, 42, 42, 42, 42, 42, 42, 42, 42,
+    42, 42, 42, 42, 42, 42, 42, 41, 41, 41, 41, 41, 41, 41, 41, 41,
+    41, 41, 41, 41, 41, 41, 41, 41, 41, 41, 41, 41, 41, 41, 41, 41,
+    41, 41, 41, 41, 41, 41, 41, 41, 41, 41, 41, 41, 41, 41, 41, 41,
+    41, 41, 41, 41, 41, 41, 41, 41, 41, 41, 41, 41, 41, 41, 41, 41,
+    41, 41, 41, 41, 41, 41, 41, 41, 41, 41, 41, 40, 40, 40, 40, 40,
+    40, 40, 40, 40, 40, 40, 40, 40, 40, 40, 40, 40, 40, 40, 40, 40,
+    40, 40, 40, 40, 40, 40, 40, 40, 40, 40, 40, 40, 40, 40, 40, 40,
+    40, 40, 40, 40, 40, 40, 40, 40, 40, 40, 40, 40, 40, 40, 40, 40,
+    40, 40, 40, 40, 40, 40, 40, 40, 40, 40, 40, 40, 40, 40, 40, 40,
+    40, 40, 39, 39, 39, 39, 39, 39, 39, 39, 39, 39, 39, 39, 39, 39,
+    39, 39, 39, 39, 39, 39, 39, 39, 39, 39, 39, 39, 39, 39, 39, 39,
+    39, 39, 39, 39, 39, 39, 39, 39, 39, 39, 39, 39, 39, 39, 39, 39,
+    39, 39, 39, 39, 39, 39, 39, 39, 39, 39, 39, 39, 39, 39, 39, 39,
+    39, 39, 39, 39, 39, 39, 39, 39, 39, 39, 39, 39, 38, 38, 38, 38,
+    38, 38, 38, 38, 38, 38, 38, 38, 38, 38, 38, 38, 38, 38, 38, 38,
+    38, 38, 38, 38, 38, 38, 38, 38, 38, 38, 38, 38, 38, 38, 38, 38,
+    38, 38, 38, 38, 38, 38, 38, 38, 38, 38, 38, 38, 38, 38, 38, 38,
+    38, 38, 38, 38, 38, 38, 38, 38, 38, 38, 38, 38, 38, 38, 38, 38,
+    38, 38, 38, 38, 38, 38, 38, 38, 38, 37, 37, 37, 37, 37, 37, 37,
+    37, 37, 37, 37, 37, 37, 37, 37, 37, 37, 37, 37, 37, 37, 37, 37,
+    37, 37, 37, 37, 37, 37, 37, 37, 37, 37, 37, 37, 37, 37, 37, 37,
+    37, 37, 37, 37, 37, 37, 37, 37, 37, 37, 37, 37, 37, 37, 37, 37,
+    37, 37, 37, 37, 37, 37, 37, 37, 37, 37, 37, 37, 37, 37, 37, 37,
+    37, 37, 37, 37, 37, 37, 37, 37, 37, 37, 36, 36, 36, 36, 36, 36,
+    36, 36, 36, 36, 36, 36, 36, 36, 36, 36, 36, 36, 36, 36, 36, 36,
+    36, 36, 36, 36, 36, 36, 36, 36, 36, 36, 36, 36, 36, 36, 36, 36,
+    36, 36, 36, 36, 36, 36, 36, 36, 36, 36, 36, 36, 36, 36, 36, 36,
+    36, 36, 36, 36, 36, 36, 36, 36, 36, 36, 36, 36, 36, 36, 36, 36,
+    36, 36, 36, 36, 36, 36, 36, 36, 36, 36, 36, 36, 36, 35, 35, 35,
+    35, 35, 35, 35, 35, 35, 35, 35, 35, 35, 35, 35, 35, 35, 35, 35,
+    35, 35, 35, 35, 35, 35, 35, 35, 35, 35, 35, 35, 35, 35, 35, 35,
+    35, 35, 35, 35, 35, 35, 35, 35, 35, 35, 35, 35, 35, 35, 35, 35,
+    35, 35, 35, 35, 35, 35, 35, 35, 35, 35, 35, 35, 35, 35, 35, 35,
+    35, 35, 35, 35, 35, 35, 35, 35, 35, 35, 35, 35, 35, 35, 35, 35,
+    35, 35, 35, 35, 35, 34, 34, 34, 34, 34, 34, 34, 34, 34, 34, 34,
+    34, 34, 34, 34, 34, 34, 34, 34, 34, 34, 34, 34, 34, 34, 34, 34,
+    34, 34, 34, 34, 34, 34, 34, 34, 34, 34, 34, 34, 34, 34, 34, 34,
+    34, 34, 34, 34, 34, 34, 34, 34, 34, 34, 34, 34, 34, 34, 34, 34,
+    34, 34, 34, 34, 34, 34, 34, 34, 34, 34, 34, 34, 34, 34, 34, 34,
+    34, 34, 34, 34, 34, 34, 34, 34, 34, 34, 34, 34, 34, 34, 34, 34,
+    34, 33, 33, 33, 33, 33, 33, 33, 33, 33, 33, 33, 33, 33, 33, 33,
+};
+
+// distance [mm] -> ADC code
+static const uint16_t mmToADC[ADC_TABLE_MAX_MM + 1] = {
+    4095, 4095, 4095, 4095, 4095, 4095, 4095, 4095, 4095, 4095, 4095, 4095, 4095, 4095, 4095, 4095,
+    4095, 4095, 4095, 4095, 4095, 4095, 4095, 4095, 4095, 4095, 4095, 4095, 4095, 4095, 4095, 4095,
+    4095, 4095, 4034, 3944, 3859, 3776, 3698, 3622, 3550, 3480, 3413, 3349, 3287, 3227, 3170, 3114,
+    3060, 3008, 2958, 2910, 2863, 2817, 2773, 2731, 2689, 2649, 2610, 2572, 2536, 2500, 2465, 2431,
+    2399, 2367, 2335, 2305, 2276, 2247, 2219, 2191, 2165, 2138, 2113, 2088, 2064, 2040, 2017, 1994,
+    1972, 1950, 1929, 1909, 1888, 1868, 1849, 1830, 1811, 1793, 1775, 1757, 1740, 1723, 1707, 1690,
+    1674, 1659, 1643, 1628, 1614, 1599, 1585, 1571, 1557, 1543, 1530, 1517, 1504, 1492, 1479, 1467,
+    1455, 1443, 1431, 1420, 1409, 1398, 1387, 1376, 1365, 1355, 1345, 1335, 1325, 1315, 1305, 1296,
+    1286, 1277, 1268, 1259, 1250, 1241, 1233, 1224, 1216, 1207, 1199, 1191, 1183, 1175, 1168, 1160,
+    1153, 1145, 1138, 1131, 1123, 1116, 1109, 1102, 1096, 1089, 1082, 1076, 1069, 1063, 1057, 1050,
+    1044, 1038, 1032, 1026, 1020, 1014, 1008, 1003, 997, 992, 986, 981, 975, 970, 965, 959,
+    954, 949, 944, 939, 934, 929, 924, 920, 915, 910, 906, 901, 896, 892, 887, 883,
+    879, 874, 870, 866, 862, 857, 853, 849, 845, 841, 837, 833, 829, 826, 822, 818,
+    814, 810, 807, 803, 800, 796, 792, 789, 785, 782, 778, 775, 772, 768, 765, 762,
+    759, 755, 752, 749, 746, 743, 740, 736, 733, 730, 727, 724, 722, 719, 716, 713,
+    710, 707, 704, 702, 699, 696, 693, 691, 688, 685, 683, 680, 677, 675, 672, 670,
+    667, 665, 662, 660, 657, 655, 653, 650, 648, 645, 643, 641, 638, 636, 634, 632,
+    629, 627, 625, 623, 621, 618, 616, 614, 612, 610, 608, 606, 604, 602, 600, 598,
+    596, 594, 592, 590, 588, 586, 584, 582, 580, 578, 576, 574, 573, 571, 569, 567,
+    565, 563, 562, 560, 558, 556, 555, 553, 551, 550, 548, 546, 544, 543, 541, 539,
+    538, 536, 535, 533, 531, 530, 528, 527, 525, 524, 522, 521, 519, 517, 516, 514,
+    513, 512, 510, 509, 507, 506, 504, 503, 501, 500, 499, 497, 496, 494, 493, 492,
+    490, 489, 488, 486, 485, 484, 482, 481, 480, 478, 477, 476, 475, 473, 472, 471,
+    470, 468, 467, 466, 465, 463, 462, 461, 460, 459, 457, 456, 455, 454, 453, 452,
+    450, 449, 448, 447, 446, 445, 444, 443, 442, 440, 439, 438, 437, 436, 435, 434,
+    433, 432, 431, 430, 429, 428, 427, 426, 425, 424, 423, 422, 421, 420, 419, 418,
+    417, 416, 415, 414, 413, 412, 411, 410, 409, 408, 407, 406, 405, 404, 403, 402,
+    402, 401, 400, 399, 398, 397, 396, 395, 394, 394, 393, 392, 391, 390, 389, 388,
+    388, 387, 386, 385, 384, 383, 383, 382, 381, 380, 379, 378, 378, 377, 376, 375,
+    374, 374, 373, 372, 371, 371, 370, 369, 368, 367, 367, 366, 365, 364, 364, 363,
+    362, 361, 361, 360, 359, 359, 358, 357, 356, 356, 355, 354, 354, 353, 352, 351,
+    351, 350, 349, 349, 348, 347, 347, 346, 345, 345, 344, 343, 343, 342, 341, 341,
+    340, 339, 339, 338, 337, 337, 336, 336, 335, 334, 334, 333, 332, 332, 331, 331,
+    330, 329, 329, 328, 327, 327, 326, 326, 325, 324, 324, 323, 323, 322, 322, 321,
+    320, 320, 319, 319, 318, 318, 317, 316, 316, 315, 315, 314, 314, 313, 312, 312,
+    311, 311, 310, 310, 309, 309, 308, 308, 307, 307, 306, 305, 305, 304, 304, 303,
+    303, 302, 302, 301, 301, 300, 300, 299, 299, 298, 298, 297, 297, 296, 296, 295,
+    295, 294, 294, 293, 293, 292, 292, 291, 291, 290, 290, 290, 289, 289, 288, 288,
+    287, 287, 286, 286, 285, 285, 284, 284, 284, 283, 283, 282, 282, 281, 281, 280,
+    280, 280, 279, 279, 278, 278, 277, 277, 276, 276, 276, 275, 275, 274, 274, 273,
+    273, 273, 272, 272, 271, 271, 271, 270, 270, 269, 269, 269, 268, 268, 267, 267,
+    267, 266, 266, 265, 265, 265, 264, 264, 263, 263, 263, 262, 262, 261, 261, 261,
+    260, 260, 259, 259, 259, 258, 258, 258, 257, 257, 256, 256, 256, 255, 255, 255,
+    254, 254, 254, 253, 253, 252, 252, 252, 251, 251, 251, 250, 250, 250, 249, 249,
+    249, 248, 248, 248, 247, 247, 247, 246, 246, 245, 245, 245, 244, 244, 244, 243,
+    243, 243, 242, 242, 242, 241, 241, 241, 241, 240, 240, 240, 239, 239, 239, 238,
+    238, 238, 237, 237, 237, 236, 236, 236, 235, 235, 235, 234, 234, 234, 234, 233,
+    233, 233, 232, 232, 232, 231, 231, 231, 231, 230, 230, 230, 229, 229, 229, 228,
+    228, 228, 228, 227, 227, 227, 226, 226, 226, 226, 225, 225, 225, 224, 224, 224,
+    224, 223, 223, 223, 222, 222, 222, 222, 221, 221, 221, 220, 220, 220, 220, 219,
+    219,
+};
+
+#endif
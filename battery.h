@@ -0,0 +1,104 @@
+/*
+ *************************************************************************************
+ * ECE 4437
+ * TEAM 5: DANK ERRORS
+ *
+ * BATTERY (SUPPLY VOLTAGE FILTER, DUTY COMPENSATION)
+ *
+ * Filters the pack voltage and scales open loop duties to it (USE_BATTERY_COMP).
+ * Include robot_profile.h and wall_control.h first.
+ *************************************************************************************
+ */
+#ifndef BATTERY_H
+#define BATTERY_H
+
+#include <stdint.h>
+#include <math.h>
+
+/*
+ *************************************************************************************
+ * DEFINING CONSTANTS
+ *************************************************************************************
+ */
+#define BATTERY_RATE_HZ     10      //pack readings per second
+#define BATTERY_ALPHA       0.05f   //low pass per reading, ~2[s] at BATTERY_RATE_HZ
+#define BATTERY_ADC_MV      3300    //ADC full scale at the pin [mV]
+#define BATTERY_SCALE_MAX   1.5f    //most a duty is raised, or lowered by 1 / this
+
+typedef struct {
+    float mv;               //filtered pack voltage [mV], 0 = no reading yet
+    float scale;            //duty multiplier, BATTERY_REFERENCE_MV / mv
+} BatteryState;
+
+/*
+ *************************************************************************************
+ * FILTER
+ *************************************************************************************
+ */
+static inline void resetBattery(BatteryState *battery) {
+    battery->mv = 0.0f;
+    battery->scale = 1.0f;
+}
+
+// 12-bit code at the divider tap -> pack voltage [mV]
+static inline float batteryCodeToMv(uint32_t code) {
+    return (float)(code & 0xFFF) * BATTERY_ADC_MV / 4095 * BATTERY_DIVIDER;
+}
+
+    /*
+     *********************************************************************************
+     *  One pack reading [mV]. The first one sets the filter, the rest are low
+     *      passed: the PWM ripple and the sag of a single turn average out, the
+     *          drain over a session does not.
+     *  Below BATTERY_MIN_MV the reading is taken as no divider (floating pin)
+     *      and the duties are left alone.
+     *********************************************************************************
+     */
+static inline float updateBattery(BatteryState *battery, float mv) {
+    if (battery->mv == 0.0f) {
+        battery->mv = mv;
+    }
+    else {
+        battery->mv += BATTERY_ALPHA * (mv - battery->mv);
+    }
+
+    if (battery->mv < BATTERY_MIN_MV) {
+        battery->scale = 1.0f;
+    }
+    else {
+        battery->scale = BATTERY_REFERENCE_MV / battery->mv;
+        if (battery->scale > BATTERY_SCALE_MAX) {
+            battery->scale = BATTERY_SCALE_MAX;
+        }
+        else if (battery->scale < 1.0f / BATTERY_SCALE_MAX) {
+            battery->scale = 1.0f / BATTERY_SCALE_MAX;
+        }
+    }
+    return battery->scale;
+}
+
+/*
+ *************************************************************************************
+ * COMPENSATION
+ *************************************************************************************
+ */
+    /*
+     *********************************************************************************
+     *  duty [1/DUTY_ONE %] tuned at BATTERY_REFERENCE_MV -> the duty that puts the
+     *      same average voltage on the motor from the pack as it is now.
+     *      Clamped to DUTY_MAX, a flat pack runs out of headroom at the top.
+     *********************************************************************************
+     */
+static inline int compensateDuty(const BatteryState *battery, int duty) {
+    int scaled = (int)roundf(duty * battery->scale);
+
+    if (scaled > DUTY_MAX) {
+        return DUTY_MAX;
+    }
+    if (scaled < -DUTY_MAX) {
+        return -DUTY_MAX;
+    }
+    return scaled;
+}
+
+#endif
@@ -0,0 +1,131 @@
+/*
+ *************************************************************************************
+ * ECE 4437
+ * TEAM 5: DANK ERRORS
+ *
+ * CPU LOAD AND DEADLINE MONITOR
+ *
+ * CPU load from idle loop gaps and rate group deadline checks, every function
+ *  takes the cycle count (DWT_CYCCNT in the firmware) as an argument.
+ *************************************************************************************
+ */
+#ifndef CPU_MONITOR_H
+#define CPU_MONITOR_H
+
+#include <stdint.h>
+
+/*
+ *************************************************************************************
+ * DEFINING CONSTANTS
+ *************************************************************************************
+ */
+#define IDLE_LOOP_MAX       2000    //longer gaps between idle calls were preemption [cycles]
+#define DEADLINE_SLACK      50      //release later than this [% of period] = deadline miss
+
+typedef struct {
+    uint32_t idleLast;      //cycle count at the previous idle call
+    uint32_t idleCycles;    //idle cycles since the reset, only cpuIdle() writes it
+    uint32_t idleAtWindow;  //idleCycles when the current window started
+    uint32_t windowStart;   //cycle count the current window started at
+    uint32_t window;        //window length [cycles]
+    uint32_t load;          //[%] over the last full window
+    uint32_t loadPeak;      //[%] worst window since the reset
+} CpuMonitor;
+
+/*
+ *************************************************************************************
+ * CYCLE COUNTER
+ *************************************************************************************
+ */
+    /*
+     *********************************************************************************
+     * Cycles from then to now. The counter wraps every ~107 seconds at 40[MHz],
+     *  the difference in uint32_t is right across the wrap.
+     *********************************************************************************
+     */
+static inline uint32_t cyclesSince(uint32_t now, uint32_t then) {
+    return now - then;
+}
+
+/*
+ *************************************************************************************
+ * CPU LOAD
+ *************************************************************************************
+ */
+static inline void resetCpuMonitor(CpuMonitor *cpu, uint32_t now, uint32_t window) {
+    cpu->idleLast = now;
+    cpu->idleCycles = 0;
+    cpu->idleAtWindow = 0;
+    cpu->windowStart = now;
+    cpu->window = window;
+    cpu->load = 0;
+    cpu->loadPeak = 0;
+}
+
+    /*
+     *********************************************************************************
+     *  From the idle function, BIOS calls it over and over when nothing else is
+     *      ready. A short gap since the last call means the CPU sat in the idle
+     *          loop, a long gap means a Hwi, Swi or Task ran in between.
+     *********************************************************************************
+     */
+static inline void cpuIdle(CpuMonitor *cpu, uint32_t now) {
+    uint32_t gap = cyclesSince(now, cpu->idleLast);
+
+    cpu->idleLast = now;
+    if (gap < IDLE_LOOP_MAX) {
+        cpu->idleCycles += gap;
+    }
+}
+
+    /*
+     *********************************************************************************
+     *  From the base tick: once window cycles have passed,
+     *      load = 100 - idle share of the window.
+     *  The tick runs at any load, so a CPU that never reaches the idle loop
+     *      still closes its windows and reads 100%.
+     *  It only reads idleCycles (one 32-bit load), so the idle function can be
+     *      preempted anywhere without masking interrupts.
+     *  Returns 1 when a window closed.
+     *********************************************************************************
+     */
+static inline int cpuLoadTick(CpuMonitor *cpu, uint32_t now) {
+    uint32_t elapsed = cyclesSince(now, cpu->windowStart);
+    uint32_t idleTotal, idle;
+
+    if ((elapsed < cpu->window) || (elapsed < 100)) {
+        return 0;
+    }
+    idleTotal = cpu->idleCycles;
+    idle = idleTotal - cpu->idleAtWindow;
+    // An idle gap that started before the window can add up past it
+    cpu->load = (idle >= elapsed) ? 0 : 100 - idle / (elapsed / 100);
+    if (cpu->load > cpu->loadPeak) {
+        cpu->loadPeak = cpu->load;
+    }
+    cpu->idleAtWindow = idleTotal;
+    cpu->windowStart = now;
+    return 1;
+}
+
+/*
+ *************************************************************************************
+ * DEADLINES
+ *************************************************************************************
+ */
+    /*
+     *********************************************************************************
+     * A release more than DEADLINE_SLACK [% of period] after the previous one,
+     *  e.g. PID_Clk held off by a higher priority Swi.
+     *********************************************************************************
+     */
+static inline int releasedLate(uint32_t start, uint32_t lastStart, uint32_t period) {
+    return cyclesSince(start, lastStart) > period + period / 100 * DEADLINE_SLACK;
+}
+
+// Still running when the next release was due
+static inline int ranPastRelease(uint32_t start, uint32_t end, uint32_t period) {
+    return cyclesSince(end, start) > period;
+}
+
+#endif
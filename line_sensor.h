@@ -0,0 +1,398 @@
+/*
+ *************************************************************************************
+ * ECE 4437
+ * TEAM 5: DANK ERRORS
+ *
+ * LINE SENSOR (THIN / THICK LINES, MARKER BARCODES, REFLECTANCE ARRAY,
+ *  THRESHOLD CALIBRATION)
+ *
+ * Classifies black runs under the light sensor and decodes marker bars from them.
+ * Include robot_profile.h first.
+ *************************************************************************************
+ */
+#ifndef LINE_SENSOR_H
+#define LINE_SENSOR_H
+
+#include <stdint.h>
+
+/*
+ *************************************************************************************
+ * DEFINING CONSTANTS
+ *************************************************************************************
+ */
+//what classifyLight() saw on this sample
+#define LINE_NONE           0
+#define LINE_THIN           1       //thin line just crossed: start / stop telemetry
+#define LINE_THICK          2       //thick line just crossed: finish
+#define LINE_CODE           3       //decodeBarcode(): multi-bar marker, code in the state
+
+//marker barcodes: a narrow start bar, then up to BARCODE_BITS_MAX bars, each
+//  narrow = 0 or wide = 1. code = 1 followed by those bits, so a lone thin line
+//  is code 1 and "narrow, narrow, wide" is 0b101 = 5
+#define BARCODE_BITS_MAX    3
+#define BARCODE_CODES       (2 << BARCODE_BITS_MAX) //table size, codes 2 .. 15
+#define BARCODE_WIDE_RATIO  2       //wide = at least this x the start bar, and at most
+                                    //  THICK_LINE_MIN samples or it reads as the finish
+
+//what a marker code asks for, BARCODE_ACTIONS (robot_profile.h) maps codes to these
+#define MARKER_NONE         0       //unassigned code, ignored
+#define MARKER_NORMAL       1       //back to the profile speed planner
+#define MARKER_FAST         2       //speed zone: boost up to ZONE_FAST_PERCENT
+#define MARKER_SLOW         3       //careful zone: never above the profile duties
+#define MARKER_TELEMETRY    4       //start / stop reading, like a thin line
+
+typedef struct {
+    int bar;                //black samples of the bar under the sensor
+    int gap;                //white samples since the last bar
+    int unit;               //start bar width [samples], 0 = no marker yet
+    int bars;               //bars after the start bar
+    uint32_t code;          //1 + bits so far, 0 = too many bars, discarded
+} BarcodeState;
+
+//threshold calibration (USE_LIGHT_CAL), counts in [samples] of the light stream
+#define LIGHT_CAL_OCTAVE    4       //histogram bins per doubling of the decay count
+#define LIGHT_CAL_BINS      (16 * LIGHT_CAL_OCTAVE) //decay counts 1 .. 65535
+#define LIGHT_CAL_WARMUP    8       //profile thresholds until this many samples, below
+                                    //  THICK_LINE_MIN so they cannot end a run alone
+#define LIGHT_CAL_UPDATE    25      //thresholds recomputed this often
+#define LIGHT_CAL_HALF_LIFE 1000    //histogram halved this often, follows drift
+#define LIGHT_CAL_MIN_BLACK 3       //black cluster weight for a split [samples]
+#define LIGHT_CAL_SPLIT     LIGHT_CAL_OCTAVE //clusters at least 2x apart [bins]
+
+typedef struct {
+    uint16_t bins[LIGHT_CAL_BINS]; //decay count histogram, log spaced
+    uint32_t samples;       //since the reset
+    uint32_t threshold;     //decay count above this = black
+    uint32_t white;         //white level, linePosition() weight 0
+    uint32_t black;         //black level, linePosition() full weight
+    int split;              //1 = both clusters seen, 0 = white only or still warming up
+} LightCalibration;
+
+//reflectance array (USE_LINE_ARRAY), element 0 is the robot's left end
+#define LINE_ARRAY_SIZE     4       //elements, adjacent bits of one GPIO port
+#define LINE_ARRAY_MASK     ((1u << LINE_ARRAY_SIZE) - 1)
+#define LINE_ARRAY_TIMEOUT  (2 * LIGHT_BLACK) //decay count of an element that never fell
+#define LINE_POSITION_ONE   100     //linePosition() units per element pitch
+#define LINE_POSITION_MAX   (LINE_POSITION_ONE * (LINE_ARRAY_SIZE - 1) / 2) //outer element
+
+/*
+ *************************************************************************************
+ * CLASSIFICATION
+ *************************************************************************************
+ */
+    /*
+     *********************************************************************************
+     *  One decay count from the light sensor. Black samples are counted in
+     *      blackCount, the line is classified on the first white sample after
+     *          it by how many black samples it took:
+     *      THIN_LINE_MIN < count < THIN_LINE_MAX   -> LINE_THIN
+     *      count > THICK_LINE_MIN                  -> LINE_THICK
+     *  Anything else keeps counting, blackCount is only cleared on a line.
+     *********************************************************************************
+     */
+static inline int classifyLight(int *blackCount, uint32_t decayCount) {
+    if (decayCount > LIGHT_BLACK) {
+        ++*blackCount;
+        return LINE_NONE;
+    }
+    if ((*blackCount > THIN_LINE_MIN) && (*blackCount < THIN_LINE_MAX)) {
+        *blackCount = 0;
+        return LINE_THIN;
+    }
+    if (*blackCount > THICK_LINE_MIN) {
+        *blackCount = 0;
+        return LINE_THICK;
+    }
+    return LINE_NONE;
+}
+
+/*
+ *************************************************************************************
+ * MARKER BARCODES
+ *************************************************************************************
+ */
+static inline void resetBarcode(BarcodeState *state) {
+    state->bar = 0;
+    state->gap = 0;
+    state->unit = 0;
+    state->bars = 0;
+    state->code = 0;
+}
+
+    /*
+     *********************************************************************************
+     *  One decay count, run-length decoded, black above threshold
+     *      (LIGHT_BLACK or the calibrated one). A bar is measured on the first
+     *      white sample after it:
+     *      count > THICK_LINE_MIN          -> LINE_THICK at once, drops any marker
+     *      first bar, THIN_LINE_MIN < count < THIN_LINE_MAX -> start bar, sets the unit
+     *      first bar, any other count      -> keeps counting, like classifyLight()
+     *      later bars, count <= THIN_LINE_MIN -> noise, dropped
+     *      later bars                      -> a bit, wide = BARCODE_WIDE_RATIO x unit
+     *  Widths are only compared inside one marker, so the speed it is crossed at
+     *      does not matter as long as a wide bar stays within THICK_LINE_MIN.
+     *      More than BARCODE_GAP_MAX white samples end the marker:
+     *      code 1 (the start bar alone)    -> LINE_THIN
+     *      code 2 .. BARCODE_CODES - 1     -> LINE_CODE, read state->code
+     *  A thin line reads BARCODE_GAP_MAX samples later than with classifyLight().
+     *********************************************************************************
+     */
+static inline int decodeBarcode(BarcodeState *state, uint32_t decayCount,
+                                uint32_t threshold) {
+    int bar = state->bar;
+    uint32_t code;
+
+    if (decayCount > threshold) {
+        ++state->bar;
+        state->gap = 0;
+        return LINE_NONE;
+    }
+
+    // The finish wins over any marker it cuts into
+    if (bar > THICK_LINE_MIN) {
+        resetBarcode(state);
+        return LINE_THICK;
+    }
+    if (state->unit == 0) {
+        if ((bar > THIN_LINE_MIN) && (bar < THIN_LINE_MAX)) {
+            state->bar = 0;
+            state->unit = bar;
+            state->code = 1;
+        }
+        return LINE_NONE;
+    }
+    state->bar = 0;
+
+    if (bar > THIN_LINE_MIN) {
+        if (++state->bars > BARCODE_BITS_MAX) {
+            state->code = 0;
+        }
+        else if (state->code != 0) {
+            state->code = (state->code << 1) | (bar >= BARCODE_WIDE_RATIO * state->unit);
+        }
+        return LINE_NONE;
+    }
+
+    if (++state->gap <= BARCODE_GAP_MAX) {
+        return LINE_NONE;
+    }
+    code = state->code;
+    resetBarcode(state);
+    state->code = code;
+    if (code == 1) {
+        return LINE_THIN;
+    }
+    return (code != 0) ? LINE_CODE : LINE_NONE;
+}
+
+// Action for a LINE_CODE, from the profile's BARCODE_ACTIONS
+static inline int markerAction(uint32_t code) {
+    static const uint8_t actions[BARCODE_CODES] = BARCODE_ACTIONS;
+
+    return (code < BARCODE_CODES) ? actions[code] : MARKER_NONE;
+}
+
+/*
+ *************************************************************************************
+ * REFLECTANCE ARRAY
+ *************************************************************************************
+ */
+    /*
+     *********************************************************************************
+     *  One read of the whole port during a decay. levels holds the elements'
+     *      input bits (bit i = element i), pending the ones still high.
+     *  Every pending element that reads low now fell at count.
+     *  Returns the elements still pending, read again until it is 0.
+     *  After the last read, recordDecays(decays, pending, 0, LINE_ARRAY_TIMEOUT)
+     *      marks the ones that never fell.
+     *********************************************************************************
+     */
+static inline uint32_t recordDecays(uint32_t decays[], uint32_t pending, uint32_t levels,
+                                    uint32_t count) {
+    uint32_t fell = pending & ~levels;
+    int i;
+
+    for (i = 0; fell != 0; ++i, fell >>= 1) {
+        if (fell & 1) {
+            decays[i] = count;
+        }
+    }
+    return pending & levels;
+}
+
+// Highest decay count of the array, what the single light sensor would read over the line
+static inline uint32_t darkestDecay(const uint32_t decays[]) {
+    uint32_t darkest = decays[0];
+    int i;
+
+    for (i = 1; i < LINE_ARRAY_SIZE; ++i) {
+        if (decays[i] > darkest) {
+            darkest = decays[i];
+        }
+    }
+    return darkest;
+}
+
+    /*
+     *********************************************************************************
+     *  Line position under the array, the darkness-weighted mean of the
+     *      element positions. Each element weighs 0 at white up to
+     *          black - white at black and above (LIGHT_WHITE and LIGHT_BLACK,
+     *              or the calibrated levels).
+     *  position is in [1/LINE_POSITION_ONE element pitch] from the center,
+     *      -LINE_POSITION_MAX..LINE_POSITION_MAX, negative = left.
+     *  Returns 0 and leaves position alone when no element is past the middle
+     *      of the white-black range (no line under the array).
+     *********************************************************************************
+     */
+static inline int linePosition(const uint32_t decays[], uint32_t white, uint32_t black,
+                               int *position) {
+    int32_t range = (int32_t)black - (int32_t)white;
+    int32_t sum = 0, total = 0, darkest = 0;
+    int i;
+
+    if (range <= 0) {
+        return 0;
+    }
+    for (i = 0; i < LINE_ARRAY_SIZE; ++i) {
+        int32_t weight = (int32_t)decays[i] - (int32_t)white;
+
+        if (weight < 0) {
+            weight = 0;
+        }
+        else if (weight > range) {
+            weight = range;
+        }
+        if (weight > darkest) {
+            darkest = weight;
+        }
+        sum += weight * (2 * i - (LINE_ARRAY_SIZE - 1));
+        total += weight;
+    }
+    if (2 * darkest < range) {
+        return 0;
+    }
+    *position = (int)((int64_t)sum * (LINE_POSITION_ONE / 2) / total);
+    return 1;
+}
+
+/*
+ *************************************************************************************
+ * THRESHOLD CALIBRATION
+ *************************************************************************************
+ */
+// Histogram bin of a decay count: the octave and the next 2 bits below its top bit
+static inline int lightBin(uint32_t count) {
+    int octave = 0;
+    int bin;
+
+    if (count == 0) {
+        return 0;
+    }
+    while ((count >> octave) > 1) {
+        ++octave;
+    }
+    bin = octave * LIGHT_CAL_OCTAVE + (int)(((count << 2) >> octave) & 3);
+    return (bin < LIGHT_CAL_BINS) ? bin : LIGHT_CAL_BINS - 1;
+}
+
+// Smallest decay count in a bin
+static inline uint32_t lightBinCount(int bin) {
+    return ((uint32_t)(LIGHT_CAL_OCTAVE + (bin & 3)) << (bin / LIGHT_CAL_OCTAVE)) >> 2;
+}
+
+// Back to the profile thresholds, until LIGHT_CAL_WARMUP new samples are in
+static inline void resetLightCalibration(LightCalibration *cal) {
+    int bin;
+
+    for (bin = 0; bin < LIGHT_CAL_BINS; ++bin) {
+        cal->bins[bin] = 0;
+    }
+    cal->samples = 0;
+    cal->threshold = LIGHT_BLACK;
+    cal->white = LIGHT_WHITE;
+    cal->black = LIGHT_BLACK;
+    cal->split = 0;
+}
+
+    /*
+     *********************************************************************************
+     *  Splits the histogram in two with Otsu's method on the log-spaced bins,
+     *      so the clusters are compared by ratio, like the decay times scale.
+     *  Both clusters (black weighs LIGHT_CAL_MIN_BLACK, LIGHT_CAL_SPLIT bins
+     *      between the means): threshold halfway between the two means in
+     *          bins (one 2-means step), levels at the means.
+     *  One cluster only (nothing black crossed yet): it is white, the threshold
+     *      is LIGHT_CAL_SPLIT bins (2x) above its mean, black twice that.
+     *********************************************************************************
+     */
+static inline void splitLightHistogram(LightCalibration *cal) {
+    float weight = 0.0f, moment = 0.0f;
+    float weight0 = 0.0f, moment0 = 0.0f;
+    float best = -1.0f, white = 0.0f, black = 0.0f, blackWeight = 0.0f;
+    int bin;
+
+    for (bin = 0; bin < LIGHT_CAL_BINS; ++bin) {
+        weight += cal->bins[bin];
+        moment += (float)bin * cal->bins[bin];
+    }
+    if (weight <= 0.0f) {
+        return;
+    }
+    for (bin = 0; bin < LIGHT_CAL_BINS - 1; ++bin) {
+        float weight1, mean0, mean1, between;
+
+        weight0 += cal->bins[bin];
+        moment0 += (float)bin * cal->bins[bin];
+        weight1 = weight - weight0;
+        if (weight0 <= 0.0f) {
+            continue;
+        }
+        if (weight1 <= 0.0f) {
+            break;
+        }
+        mean0 = moment0 / weight0;
+        mean1 = (moment - moment0) / weight1;
+        between = weight0 * weight1 * (mean1 - mean0) * (mean1 - mean0);
+        if (between > best) {
+            best = between;
+            white = mean0;
+            black = mean1;
+            blackWeight = weight1;
+        }
+    }
+
+    cal->split = (blackWeight >= LIGHT_CAL_MIN_BLACK) && (black - white >= LIGHT_CAL_SPLIT);
+    if (!cal->split) {
+        white = moment / weight;
+        black = white + 2 * LIGHT_CAL_SPLIT;
+    }
+    cal->white = lightBinCount((int)(white + 0.5f));
+    cal->black = lightBinCount((int)(black + 0.5f));
+    cal->threshold = lightBinCount((int)((white + black) / 2 + 0.5f));
+}
+
+    /*
+     *********************************************************************************
+     *  One decay count into the histogram. From LIGHT_CAL_WARMUP on the thresholds
+     *      are recomputed every LIGHT_CAL_UPDATE samples, every LIGHT_CAL_HALF_LIFE
+     *          samples all bins are halved so old light conditions fade out.
+     *********************************************************************************
+     */
+static inline void updateLightCalibration(LightCalibration *cal, uint32_t count) {
+    int bin;
+
+    ++cal->bins[lightBin(count)];
+    ++cal->samples;
+    if ((cal->samples % LIGHT_CAL_HALF_LIFE) == 0) {
+        for (bin = 0; bin < LIGHT_CAL_BINS; ++bin) {
+            cal->bins[bin] >>= 1;
+        }
+    }
+    if ((cal->samples == LIGHT_CAL_WARMUP) ||
+        ((cal->samples > LIGHT_CAL_WARMUP) && ((cal->samples % LIGHT_CAL_UPDATE) == 0))) {
+        splitLightHistogram(cal);
+    }
+}
+
+#endif
@@ -0,0 +1,25 @@
+/*
+ *************************************************************************************
+ * MOTOR CALIBRATION
+ *
+ * GENERATED BY tools/motor_cal.c - DO NOT EDIT
+ *
+ * Per motor: speed [mm/s] = slope * (duty - deadband) above the deadband.
+ * A commanded duty c stands for REFERENCE * c [mm/s] on both wheels, the
+ *  firmware drives each motor at deadband + c * REFERENCE / slope.
+ * Calibrated, REFERENCE is also MM_PER_SEC_PER_DUTY (robot_profile.h).
+ * Uncalibrated: no measurements, commanded duty = motor duty.
+ *************************************************************************************
+ */
+#ifndef MOTOR_CALIBRATION_H
+#define MOTOR_CALIBRATION_H
+
+#define MOTOR_CAL_VALID      0
+#define MOTOR_CAL_REFERENCE  1.0000f //[mm/s per %] of a commanded duty
+
+#define MOTOR_CAL_SLOPE_L    1.0000f //[mm/s per %]
+#define MOTOR_CAL_DEADBAND_L 0.00f   //[%]
+#define MOTOR_CAL_SLOPE_R    1.0000f //[mm/s per %]
+#define MOTOR_CAL_DEADBAND_R 0.00f   //[%]
+
+#endif
@@ -0,0 +1,348 @@
+/*
+ *************************************************************************************
+ * ECE 4437
+ * TEAM 5: DANK ERRORS
+ *
+ * ROBOT PROFILES
+ *************************************************************************************
+ */
+
+/*
+ *************************************************************************************
+ * HOW TO PICK A PROFILE
+ *
+ * Every tuned value of a build lives in one profile block below. Pick the build with
+ *  the compiler option, no source edits:
+ *      --define=ROBOT_PROFILE=PROFILE_V10     (CCS: Build > Predefined Symbols)
+ *
+ * Everything is a #define, so thresholds and duty counts are folded into
+ *  immediates by the compiler. Switching profiles costs nothing at run time.
+ *
+ * To add a course or chassis: copy a block, give it a new number, retune.
+ *************************************************************************************
+ */
+#ifndef ROBOT_PROFILE_H
+#define ROBOT_PROFILE_H
+
+#include "motor_calibration.h"    //MOTOR_CAL_REFERENCE, see MM_PER_SEC_PER_DUTY
+
+#define PROFILE_FINAL       1   //team5_dank_errors_final.c: raced thresholds and duties,
+                                //  planner and options on top
+#define PROFILE_V10         2   //milestone 9 & 10 builds (v10.1, v10.2)
+
+#ifndef ROBOT_PROFILE
+#define ROBOT_PROFILE       PROFILE_FINAL
+#endif
+
+//PWM options, same way: --define=PWM_HIGH_RES=1
+//PWM_HIGH_RES = 0: the profile's low PWM_FREQ at the /64 divider (62 counts at 10[kHz])
+//PWM_HIGH_RES = 1: the profile's high PWM_FREQ (above the audible band) at the
+//  smallest divider that fits the 16-bit counter (2000 counts at 20[kHz])
+//PWM_DITHER = 1: ditherISR() sigma-delta dithers each compare across periods,
+//  the average duty gets 1/16 count of resolution
+#ifndef PWM_HIGH_RES
+#define PWM_HIGH_RES        0
+#endif
+#ifndef PWM_DITHER
+#define PWM_DITHER          0
+#endif
+
+//USE_QEI = 1: wheel encoders on QEI0 (left) and QEI1 (right), the duties PID() picks
+//  become wheel speed targets for an inner speed loop (wheel_control.h)
+//  maze_sim -q, 1000 runs: 8.1% crashes vs 24.4% open loop with the motors 5% apart
+//  (-n motorMismatch=0.05), but 7.4% vs 2.9% with the default noise, so only worth
+//  it on a robot with badly matched motors
+#ifndef USE_QEI
+#define USE_QEI             0
+#endif
+
+//USE_BATTERY_COMP = 1: the pack voltage through a divider on AIN8 (PE5) scales every
+//  open loop duty to the voltage it was tuned at (battery.h), with USE_QEI the wheel
+//  loop makes up for the pack instead
+#ifndef USE_BATTERY_COMP
+#define USE_BATTERY_COMP    0
+#endif
+
+//USE_LEFT_SENSOR = 1: a third IR sensor facing left on AIN9 (PE4), PID() centers
+//  between both walls when it sees them and follows the right wall otherwise
+#ifndef USE_LEFT_SENSOR
+#define USE_LEFT_SENSOR     0
+#endif
+
+//USE_LINE_ARRAY = 1: a reflectance array of RC-decay elements on PA2-PA5 replaces the
+//  PF4 light sensor, timed in one pass and giving a line position (line_sensor.h)
+#ifndef USE_LINE_ARRAY
+#define USE_LINE_ARRAY      0
+#endif
+
+//USE_LIGHT_CAL = 1: the black threshold and the white / black levels are learned
+//  from the decay counts of the run, LIGHT_BLACK and LIGHT_WHITE only cover its
+//  first few samples (line_sensor.h)
+//  maze_sim -l, 400 runs: 1.8% failures with the light counts x0.5 .. x4.0, against
+//  1.8% at x1.0 but 99.8% at x0.5, 53.2% at x2.5 and 99.8% at x4.0 with LIGHT_BLACK
+#ifndef USE_LIGHT_CAL
+#define USE_LIGHT_CAL       0
+#endif
+
+/*
+ *************************************************************************************
+ * PROFILE: FINAL
+ *************************************************************************************
+ */
+#if ROBOT_PROFILE == PROFILE_FINAL
+#define PROFILE_NAME        "FINAL"
+
+// PWM
+#if PWM_HIGH_RES
+#define PWM_FREQ            20000   //[Hz], lowest frequency above the audible band
+#else
+#define PWM_FREQ            10000   //[Hz]
+#endif
+#define PWM_ADJUST          80      //duty before the first PID tick [%]
+
+// Wheels
+#define MM_PER_SEC_PER_DUTY_UNCAL 5.0f //forward speed per % duty (tuned on the course)
+#define WHEEL_BASE_MM       100.0f  //distance between the wheels
+#define WHEEL_DIAMETER_MM   32.0f
+#define QEI_COUNTS_PER_REV  1200    //x4 quadrature counts per wheel turn
+#define WHEEL_KP            0.10f   //inner speed loop (USE_QEI) [% per mm/s]
+#define WHEEL_KI            2.0f    //                           [% per mm]
+
+// Battery (USE_BATTERY_COMP)
+#define BATTERY_REFERENCE_MV 8000.0f //pack voltage the duties above were tuned at
+#define BATTERY_DIVIDER     3.0f    //pack / ADC pin, 10k over 4.99k keeps 8.4[V] < 3.3[V]
+#define BATTERY_MIN_MV      5000.0f //below: no divider fitted, duties left alone
+
+// Wall following
+#define TARGET_ADC          2000    //desired right wall reading, ~79[mm]
+#define BUFFER_SIZE         20      //error values per printed line
+#define CORRIDOR_ENTER_MM   180     //USE_LEFT_SENSOR: center with both walls inside this
+#define CORRIDOR_EXIT_MM    240     //                 back to the right wall past this
+
+// Front sensor thresholds [ADC code], the raced codes: a whole [mm] through
+//  MM_TO_ADC() lands up to 7 codes off them
+#define FRONT_UTURN_ADC     2000    //~79[mm]: dead end ahead
+#define FRONT_CLEAR_ADC     1000    //~168[mm]: nothing close ahead
+#define FRONT_SHARP_ADC     1400    //~117[mm]: room for a sharp right
+#define FRONT_STRAIGHT_ADC  1800    //~89[mm]: room to keep going straight
+#define FRONT_SPECIAL_ADC   1500    //~108[mm]: upper bound for special straight
+
+// pidRight thresholds
+#define PID_UTURN_MAX       25      //U-turn below this (with a wall ahead)
+#define PID_LEFT_MIN        27      //turn left above this
+#define PID_RIGHT_MIN       -80     //turn right between these two
+#define PID_RIGHT_MAX       -20
+#define PID_SHARP_MAX       -100    //sharp right below this
+#define PID_STRAIGHT_BAND   20      //straight inside +/- this
+#define PID_SPECIAL_MIN     -50     //special straight between this and 0
+
+// PID gains (wall_control.h)
+#define PID_KP              0.05f   //1/20
+#define PID_KD              1.0f    //(3 / 2) in the original integer math
+#define PID_KP_FAST         0.04f   //at SPEED_MAX_PERCENT
+#define PID_KD_FAST         0.7f
+
+// Speed planner, SPEED_MAX_PERCENT 100 and SPEED_MIN_PERCENT 100 = fixed duties
+#define SPEED_MAX_PERCENT   120     //cruise duties x this with a clear straight ahead
+#define SPEED_MIN_PERCENT   85      //cruise duties x this close to a wall
+#define SPEED_CLEAR_MM      400     //full speed with this much room ahead
+#define SPEED_BRAKE_MM      250     //profile duties here
+#define SPEED_SLOW_MM       120     //SPEED_MIN_PERCENT here and closer
+#define SPEED_STEADY_BAND   150     //speed up only while |error| is inside this [ADC]
+#define SPEED_RAMP_UP       100.0f  //[%/s]
+
+// Marker speed zones (wall_control.h), MARKER_FAST / MARKER_SLOW switch to them
+#define ZONE_FAST_PERCENT   140     //boost limit in a fast zone
+#define PID_KP_ZONE         0.03f   //gains at ZONE_FAST_PERCENT
+#define PID_KD_ZONE         0.4f
+
+// Branch duties [%], L = left motor, R = right motor
+#define DUTY_UTURN          99      //left wheel reversed
+#define REVERSE_BRAKE_MS    100     //hard stop before a wheel reverses (U-turn), 0 = off
+#define DUTY_LEFT_L         70
+#define DUTY_LEFT_R         80
+#define DUTY_RIGHT_L        75
+#define DUTY_RIGHT_R        65
+#define DUTY_SHARP_L        99
+#define DUTY_SHARP_R        17
+#define DUTY_STRAIGHT       70
+#define DUTY_SPECIAL        80
+
+// Light sensor (course markers)
+#define LIGHT_BLACK         2000    //decay count above this = black surface
+#define LIGHT_WHITE         1000    //decay count of a white surface (USE_LINE_ARRAY)
+#define THIN_LINE_MIN       1       //thin line: more than this many black samples
+#define THIN_LINE_MAX       10      //           and less than this many
+#define THICK_LINE_MIN      10      //thick line: more than this many
+
+// Marker barcodes (line_sensor.h), MARKER_* for every code, unlisted = MARKER_NONE
+#define BARCODE_GAP_MAX     8       //white samples between the bars of one marker
+#define BARCODE_ACTIONS     { MARKER_NONE, MARKER_NONE,                               \
+                              MARKER_FAST,      /* 2: narrow, narrow */               \
+                              MARKER_NORMAL,    /* 3: narrow, wide */                 \
+                              MARKER_SLOW,      /* 4: narrow, narrow, narrow */       \
+                              MARKER_TELEMETRY  /* 5: narrow, narrow, wide */ }
+
+/*
+ *************************************************************************************
+ * PROFILE: V10
+ *************************************************************************************
+ */
+#elif ROBOT_PROFILE == PROFILE_V10
+#define PROFILE_NAME        "V10"
+
+// PWM
+#if PWM_HIGH_RES
+#define PWM_FREQ            20000
+#else
+#define PWM_FREQ            10000
+#endif
+#define PWM_ADJUST          83
+
+// Wheels
+#define MM_PER_SEC_PER_DUTY_UNCAL 5.0f
+#define WHEEL_BASE_MM       100.0f
+#define WHEEL_DIAMETER_MM   32.0f
+#define QEI_COUNTS_PER_REV  1200
+#define WHEEL_KP            0.10f
+#define WHEEL_KI            2.0f
+
+// Battery
+#define BATTERY_REFERENCE_MV 8000.0f
+#define BATTERY_DIVIDER     3.0f
+#define BATTERY_MIN_MV      5000.0f
+
+// Wall following
+#define TARGET_ADC          2048    //ADC_MAX_VALUE / 2, ~77[mm]
+#define BUFFER_SIZE         20
+#define CORRIDOR_ENTER_MM   180
+#define CORRIDOR_EXIT_MM    240
+
+// Front sensor thresholds [ADC code]
+#define FRONT_UTURN_ADC     2000
+#define FRONT_CLEAR_ADC     1000
+#define FRONT_SHARP_ADC     1400
+#define FRONT_STRAIGHT_ADC  1800
+#define FRONT_SPECIAL_ADC   1500
+
+// pidRight thresholds
+#define PID_UTURN_MAX       25
+#define PID_LEFT_MIN        27
+#define PID_RIGHT_MIN       -80
+#define PID_RIGHT_MAX       -20
+#define PID_SHARP_MAX       -100
+#define PID_STRAIGHT_BAND   20
+#define PID_SPECIAL_MIN     -50
+
+// PID gains
+#define PID_KP              0.05f
+#define PID_KD              1.0f
+#define PID_KP_FAST         0.05f
+#define PID_KD_FAST         1.0f
+
+// Speed planner (off, fixed duties as raced)
+#define SPEED_MAX_PERCENT   100
+#define SPEED_MIN_PERCENT   100
+#define SPEED_CLEAR_MM      400
+#define SPEED_BRAKE_MM      250
+#define SPEED_SLOW_MM       120
+#define SPEED_STEADY_BAND   150
+#define SPEED_RAMP_UP       100.0f
+#define ZONE_FAST_PERCENT   100
+#define PID_KP_ZONE         0.05f
+#define PID_KD_ZONE         1.0f
+
+// Branch duties [%]
+#define DUTY_UTURN          99
+#define REVERSE_BRAKE_MS    0
+#define DUTY_LEFT_L         70
+#define DUTY_LEFT_R         80
+#define DUTY_RIGHT_L        80
+#define DUTY_RIGHT_R        70
+#define DUTY_SHARP_L        99
+#define DUTY_SHARP_R        20
+#define DUTY_STRAIGHT       80
+#define DUTY_SPECIAL        80
+
+// Light sensor (course markers)
+#define LIGHT_BLACK         2000
+#define LIGHT_WHITE         1000
+#define THIN_LINE_MIN       1
+#define THIN_LINE_MAX       10
+#define THICK_LINE_MIN      10
+#define BARCODE_GAP_MAX     8
+#define BARCODE_ACTIONS     { MARKER_NONE, MARKER_NONE, MARKER_FAST, MARKER_NORMAL, \
+                              MARKER_SLOW, MARKER_TELEMETRY }
+
+#else
+#error "Unknown ROBOT_PROFILE"
+#endif
+
+/*
+ *************************************************************************************
+ * DERIVED VALUES (same for every profile)
+ *************************************************************************************
+ */
+#define SYSTEM_CLOCK_HZ     40000000 //SYSCTL_SYSDIV_5 with the 200[MHz] PLL
+#if !PWM_HIGH_RES
+#define PWM_DIVIDER         64       //SYSCTL_PWMDIV_64
+#elif (SYSTEM_CLOCK_HZ / PWM_FREQ) <= 0x10000
+#define PWM_DIVIDER         1        //most counts per period
+#elif (SYSTEM_CLOCK_HZ / 2 / PWM_FREQ) <= 0x10000
+#define PWM_DIVIDER         2
+#elif (SYSTEM_CLOCK_HZ / 4 / PWM_FREQ) <= 0x10000
+#define PWM_DIVIDER         4
+#elif (SYSTEM_CLOCK_HZ / 8 / PWM_FREQ) <= 0x10000
+#define PWM_DIVIDER         8
+#elif (SYSTEM_CLOCK_HZ / 16 / PWM_FREQ) <= 0x10000
+#define PWM_DIVIDER         16
+#elif (SYSTEM_CLOCK_HZ / 32 / PWM_FREQ) <= 0x10000
+#define PWM_DIVIDER         32
+#else
+#define PWM_DIVIDER         64
+#endif
+#define PWM_CLOCK           (SYSTEM_CLOCK_HZ / PWM_DIVIDER)
+#define PWM_LOAD            ((PWM_CLOCK / PWM_FREQ) - 1)
+
+// Forward speed per % of commanded duty [mm/s]. A motor calibration makes every
+//  commanded % worth MOTOR_CAL_REFERENCE on both wheels, so the estimator, the wheel
+//  loop targets and tools/maze_sim.c take that; the profile's course-tuned value
+//  only holds for an uncalibrated build
+#if MOTOR_CAL_VALID
+#define MM_PER_SEC_PER_DUTY MOTOR_CAL_REFERENCE
+#else
+#define MM_PER_SEC_PER_DUTY MM_PER_SEC_PER_DUTY_UNCAL
+#endif
+
+// Duty [%] -> PWM compare count, a constant for every literal duty
+#define DUTY_COUNT(percent) ((percent) * PWM_LOAD / 100)
+
+// Commanded duties are in 1/DUTY_ONE [%], finer steps only pay off with the
+//  counts (or the dithering) to show them
+#if PWM_HIGH_RES || PWM_DITHER
+#define DUTY_ONE            10
+#else
+#define DUTY_ONE            1
+#endif
+
+#if (SPEED_MIN_PERCENT > 100) || (SPEED_MAX_PERCENT < 100) || \
+    (SPEED_SLOW_MM >= SPEED_BRAKE_MM) || (SPEED_BRAKE_MM >= SPEED_CLEAR_MM)
+#error "speed planner needs MIN <= 100 <= MAX and SLOW < BRAKE < CLEAR"
+#endif
+
+// Duties index pwmCompare[] in the firmware, DUTY_MAX in wall_control.h
+#if (DUTY_UTURN > 99) || (DUTY_LEFT_L > 99) || (DUTY_LEFT_R > 99) || (DUTY_RIGHT_L > 99) || \
+    (DUTY_RIGHT_R > 99) || (DUTY_SHARP_L > 99) || (DUTY_SHARP_R > 99) || \
+    (DUTY_STRAIGHT > 99) || (DUTY_SPECIAL > 99) || (PWM_ADJUST > 99)
+#error "duties must be 0..99 [%]"
+#endif
+
+#if (PWM_LOAD < 2) || (PWM_LOAD > 0xFFFF)
+#error "PWM_FREQ does not fit the 16-bit PWM counter at this divider"
+#endif
+
+#if PWM_HIGH_RES && (PWM_FREQ < 20000)
+#error "PWM_HIGH_RES needs a PWM_FREQ above the audible band"
+#endif
+
+#endif
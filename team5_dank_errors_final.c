@@ -10,17 +10,35 @@
  *************************************************************************************
  * TO RUN THIS FILE, YOU NEED TO HAVE THESE RTOS PRODUCTS ENABLED
  *
- * SWI:
- * {{ Buffer_SWI | switchBuffers | 15 | 0x0 }}
+ * TASK:
+ * {{ Telemetry_Task | telemetryTask | priority 1 | stack 1024 }}
+ *
+ * MAILBOX:
+ * {{ Telemetry_Mbx | message size 40 (sizeof(TelemetryMsg)) | 16 messages }}
+ *
+ * IDLE:
+ * {{ cpuLoadIdle | add to the Idle function list }}
  *
  * TIMER:
  * {{ Light_Timer | lightSensorCalculation | 2 | 10000 | timer starts automatically |
  *      periodic and continuous }}
  *
+ * ONLY WHEN HIGH_RATE_MODE = 0 (leave it out otherwise, controlISR() owns the loop):
  * CLK: period = 50000 (us) | ANY | Timer Interrupt Every Period | SWI priority = 14
- * {{ Buffer_Clk | OutputBuffer | 1 | 40 | DO NOT start at boot time }}
  * {{ PID_Clk | prepPID | 1 | 1 | start at boot time }}
  *
+ * ONLY WHEN HIGH_RATE_MODE = 1 OR ADC_PWM_TRIGGER = 1:
+ * HWI:
+ * {{ Control_HWI | controlISR | interrupt number 30 (ADC0 SS0) | priority 0x20 }}
+ *
+ * ONLY WHEN PWM_DITHER = 1 (robot_profile.h):
+ * HWI:
+ * {{ Dither_HWI | ditherISR | interrupt number 151 (PWM1 generator 1) | priority 0x20 }}
+ *
+ * ONLY WHEN USE_QEI = 1 (robot_profile.h):
+ * HWI:
+ * {{ Wheel_HWI | wheelISR | interrupt number 29 (QEI0) | priority 0x20 }}
+ *
  *
  *************************************************************************************
  */
@@ -35,6 +53,8 @@
 #include <xdc/runtime/Log.h>       //needed for any Log_info() call
 #include <xdc/cfg/global.h>        //header file for statically defined objects/handles
 #include <xdc/runtime/Timestamp.h> //used for Timestamp() calls
+#include <ti/sysbios/knl/Mailbox.h> //used for Mailbox_post/pend() calls
+#include <ti/sysbios/hal/Hwi.h>    //used for Hwi_disable/restore() calls
 /*
  *************************************************************************************
  * C HEADER FILES
@@ -42,6 +62,7 @@
  */
 #include <stdint.h>
 #include <stdbool.h>
+#include <stdlib.h>
 #include <string.h>
 #include <math.h>
 /*
@@ -51,6 +72,8 @@
  */
 #include "inc/hw_memmap.h"
 #include "inc/hw_types.h"
+#include "inc/hw_gpio.h"
+#include "inc/hw_pwm.h"
 #include "driverlib/debug.h"
 #include "driverlib/fpu.h"
 #include "driverlib/gpio.h"
@@ -64,28 +87,246 @@
 #include "driverlib/pwm.c"
 #include "inc/hw_ints.h"
 #include "driverlib/timer.c"
+#include "driverlib/qei.c"
 #include "driverlib/udma.h"
 #include "inc/hw_udma.h"
 #include "inc/hw_uart.h"
 #include "driverlib/systick.h"
+/*
+ *************************************************************************************
+ * LOCAL HEADER FILES
+ *************************************************************************************
+ */
+#include "adc_distance_table.h"   //generated by tools/gen_adc_table.c
+#include "robot_profile.h"        //tuned values, pick with ROBOT_PROFILE
+#include "telemetry_codec.h"      //delta + varint frames, see tools/telemetry_decode.c
+#include "wall_control.h"         //PID, branches and speed planner, shared with tools/maze_sim.c
+#include "line_sensor.h"          //thin / thick line classification, shared with the tools
+#include "motor_calibration.h"    //per-motor duty curves, generated by tools/motor_cal.c
+#include "wheel_control.h"        //encoder speed and inner wheel loop, shared with tools/maze_sim.c
+#include "battery.h"              //pack voltage filter and duty scaling, shared with tools/maze_sim.c
+#include "cpu_monitor.h"          //CPU load and deadline math, tested by tools/cpu_monitor_test.c
 
 /*
  *************************************************************************************
  * DEFINING CONSTANTS
  *************************************************************************************
  */
-//used constants to make code easy to read for PWM config
-#define PWM_FREQ            10000
-#define PWM_ADJUST          80
-#define TARGET_VALUE        2000
+//used constants to make code easy to read for ADC config
+//PWM, target, thresholds and duties come from robot_profile.h
+//TARGET_VALUE, FRONT_* and BRANCH_* are in wall_control.h
+#define SEQ0                0
 #define SEQ1                1
 #define SEQ2                2
 #define SEQ3                3
 #define SEQ4                4
 #define PRI_0               0
 #define PRI_1               1
+#define PRI_3               3
 #define STEP_0              0
-#define BUFFER_SIZE         20 //size of each buffer
+
+//used constants for the control loop rate
+//HIGH_RATE_MODE = 0: PID_Clk runs prepPID() every 50[ms] (20 Hz)
+//HIGH_RATE_MODE = 1: Timer1 triggers the ADC, controlISR() runs at CONTROL_RATE_HZ
+#define HIGH_RATE_MODE      0
+#if HIGH_RATE_MODE
+#define CONTROL_RATE_HZ     500     //200 to 1000
+#else
+#define CONTROL_RATE_HZ     20
+#endif
+#if HIGH_RATE_MODE && ((CONTROL_RATE_HZ < 200) || (CONTROL_RATE_HZ > 1000))
+#error "CONTROL_RATE_HZ must be 200 to 1000 in HIGH_RATE_MODE"
+#endif
+#define CONTROL_PERIOD      (1.0f / CONTROL_RATE_HZ) //base tick [s]
+
+//used constants for the IR sampling trigger
+//ADC_PWM_TRIGGER = 0: processor trigger in senseGroup(), or Timer1 in HIGH_RATE_MODE
+//ADC_PWM_TRIGGER = 1: PWM1 generator 2, phase locked to the motor generator, triggers
+//  ADC0 SS0 once per PWM period between switching edges, controlISR() averages
+//  ADC_AVERAGE_PERIODS whole periods into each reading
+//In HIGH_RATE_MODE the window is the whole base tick and its end is the base tick
+#define ADC_PWM_TRIGGER     0
+#if HIGH_RATE_MODE
+#define ADC_AVERAGE_PERIODS (PWM_FREQ / CONTROL_RATE_HZ)
+#else
+#define ADC_AVERAGE_PERIODS 10      //1[ms] at 10[kHz], newest reading at most this old
+#endif
+#if ADC_PWM_TRIGGER && HIGH_RATE_MODE && (PWM_FREQ % CONTROL_RATE_HZ)
+#error "PWM_FREQ must be a multiple of CONTROL_RATE_HZ with ADC_PWM_TRIGGER"
+#endif
+#if ADC_PWM_TRIGGER && ((ADC_AVERAGE_PERIODS < 1) || (ADC_AVERAGE_PERIODS > 256))
+#error "ADC_AVERAGE_PERIODS must be 1 to 256"
+#endif
+#define ADC_STEPS           (2 + USE_LEFT_SENSOR) //SS0 samples per trigger: right, front, left
+
+//used constants for the PWM, PWM_HIGH_RES / PWM_DITHER / DUTY_ONE are in robot_profile.h
+#if PWM_DIVIDER == 1
+#define PWM_DIV_CONFIG      SYSCTL_PWMDIV_1
+#elif PWM_DIVIDER == 2
+#define PWM_DIV_CONFIG      SYSCTL_PWMDIV_2
+#elif PWM_DIVIDER == 4
+#define PWM_DIV_CONFIG      SYSCTL_PWMDIV_4
+#elif PWM_DIVIDER == 8
+#define PWM_DIV_CONFIG      SYSCTL_PWMDIV_8
+#elif PWM_DIVIDER == 16
+#define PWM_DIV_CONFIG      SYSCTL_PWMDIV_16
+#elif PWM_DIVIDER == 32
+#define PWM_DIV_CONFIG      SYSCTL_PWMDIV_32
+#else
+#define PWM_DIV_CONFIG      SYSCTL_PWMDIV_64
+#endif
+#if PWM_DITHER
+#define DITHER_BITS         4       //fraction bits of pwmCompare[], 1/16 count
+#else
+#define DITHER_BITS         0
+#endif
+#define DITHER_MASK         ((1 << DITHER_BITS) - 1)
+#define PWM_LOAD_REG        (PWM_LOAD - 1) //LOAD register, PWMGenPeriodSet() counting down
+#if (PWM_LOAD << DITHER_BITS) > 0xFFFF
+#error "PWM_LOAD does not fit pwmCompare[] with DITHER_BITS fraction bits"
+#endif
+#if ADC_PWM_TRIGGER
+#define PWM_SYNC_BITS       (PWM_CTL_GLOBALSYNC1 | PWM_CTL_GLOBALSYNC2) //motors + ADC trigger
+#else
+#define PWM_SYNC_BITS       PWM_CTL_GLOBALSYNC1
+#endif
+#define REVERSE_BRAKE_TICKS ((REVERSE_BRAKE_MS * STATS_TICK_HZ + 999) / 1000) //PID() ticks
+
+//used constants for the rate groups, run every DIVIDER base ticks
+//BUDGET = share of the group's period it may use before it counts as an overrun
+#define SENSE_DIVIDER       1
+#define SENSE_BUDGET        25      //[%]
+#define CONTROL_DIVIDER     1
+#define CONTROL_BUDGET      25      //[%]
+#define BATTERY_GROUP_DIVIDER (CONTROL_RATE_HZ / BATTERY_RATE_HZ) //USE_BATTERY_COMP
+#define BATTERY_BUDGET      10      //[%]
+#if USE_BATTERY_COMP
+#define RATE_GROUPS         3
+#else
+#define RATE_GROUPS         2
+#endif
+
+//used constants for the CPU load and deadline monitor (IDLE_LOOP_MAX, DEADLINE_SLACK
+//  in cpu_monitor.h)
+#define DWT_CTRL            0xE0001000 //DWT control, bit 0 = CYCCNTENA
+#define DWT_CYCCNT          0xE0001004 //DWT cycle counter
+#define DEMCR               0xE000EDFC //debug exception monitor control
+#define DEMCR_TRCENA        0x01000000 //enables the DWT
+#define CONSOLE_POLL_TICKS  10      //telemetryTask checks the console this often [Clock ticks]
+
+//telemetry output format
+//TELEMETRY_COMPRESSED = 0: "%X, " text for PuTTY
+//TELEMETRY_COMPRESSED = 1: binary delta + varint frames, read with tools/telemetry_decode
+#define TELEMETRY_COMPRESSED 0
+
+//telemetry message types posted to Telemetry_Mbx
+#define TELEMETRY_START     0       //thin line, first pass
+#define TELEMETRY_SNAPSHOT  1       //values[] = one sample of every channel
+#define TELEMETRY_STOP      2       //thin line, second pass
+#define TELEMETRY_FINISH    3       //thick line
+
+//telemetry schema, channel numbers (CHANNEL_*) are in telemetry_codec.h
+//PID() posts a snapshot of every channel at SNAPSHOT_HZ, telemetryTask() keeps
+//  RATE_x of them per second and prints a line every DEPTH_x kept samples
+#define SNAPSHOT_HZ         20      //fastest channel rate [Hz]
+#define SNAPSHOT_DIVIDER    (CONTROL_RATE_HZ / CONTROL_DIVIDER / SNAPSHOT_HZ)
+#define RATE_ERROR          10      //[Hz]
+#define DEPTH_ERROR         BUFFER_SIZE //[samples per line]
+#define RATE_RIGHT          10
+#define DEPTH_RIGHT         20
+#define RATE_FRONT          10
+#define DEPTH_FRONT         20
+#define RATE_PID            20
+#define DEPTH_PID           40
+#define RATE_BRANCH         20
+#define DEPTH_BRANCH        40
+#define RATE_DUTY           5       //both duty channels
+#define DEPTH_DUTY          10
+#define RATE_DIRECTION      5
+#define DEPTH_DIRECTION     10
+#define RATE_LIGHT          5
+#define DEPTH_LIGHT         10
+#define CHANNEL_OK(hz, depth) (((SNAPSHOT_HZ % (hz)) == 0) && \
+                               ((depth) > 0) && ((depth) <= CODEC_MAX_SAMPLES))
+#if ((CONTROL_RATE_HZ / CONTROL_DIVIDER) % SNAPSHOT_HZ) != 0
+#error "SNAPSHOT_HZ must divide the control rate"
+#endif
+#if !(CHANNEL_OK(RATE_ERROR, DEPTH_ERROR) && CHANNEL_OK(RATE_RIGHT, DEPTH_RIGHT) && \
+      CHANNEL_OK(RATE_FRONT, DEPTH_FRONT) && CHANNEL_OK(RATE_PID, DEPTH_PID) && \
+      CHANNEL_OK(RATE_BRANCH, DEPTH_BRANCH) && CHANNEL_OK(RATE_DUTY, DEPTH_DUTY) && \
+      CHANNEL_OK(RATE_DIRECTION, DEPTH_DIRECTION) && CHANNEL_OK(RATE_LIGHT, DEPTH_LIGHT))
+#error "every RATE_x must divide SNAPSHOT_HZ and every DEPTH_x must fit one frame"
+#endif
+
+//link budget, checked at build time against the schema above
+//worst-case bytes: text "-1234, " per sample and "PARTIAL DIRECTION: \r\n" per line,
+//  frames ~2 bytes per delta sample and header + checksum per line
+#define LINK_BYTES_PER_SEC  11520   //115200 baud, 10 bits per byte
+#define LINK_BUDGET         80      //[%] left for the schema, rest for status lines
+#if TELEMETRY_COMPRESSED
+#define SAMPLE_BYTES        2
+#define LINE_BYTES          (CODEC_HEADER + 1)
+#else
+#define SAMPLE_BYTES        7
+#define LINE_BYTES          21
+#endif
+#define CHANNEL_BYTES(hz, depth) ((hz) * SAMPLE_BYTES + ((hz) * LINE_BYTES + (depth) - 1) / (depth))
+#define SCHEMA_BYTES_PER_SEC (CHANNEL_BYTES(RATE_ERROR, DEPTH_ERROR) + \
+                              CHANNEL_BYTES(RATE_RIGHT, DEPTH_RIGHT) + \
+                              CHANNEL_BYTES(RATE_FRONT, DEPTH_FRONT) + \
+                              CHANNEL_BYTES(RATE_PID, DEPTH_PID) + \
+                              CHANNEL_BYTES(RATE_BRANCH, DEPTH_BRANCH) + \
+                              2 * CHANNEL_BYTES(RATE_DUTY, DEPTH_DUTY) + \
+                              CHANNEL_BYTES(RATE_DIRECTION, DEPTH_DIRECTION) + \
+                              CHANNEL_BYTES(RATE_LIGHT, DEPTH_LIGHT))
+#if SCHEMA_BYTES_PER_SEC > (LINK_BYTES_PER_SEC * LINK_BUDGET / 100)
+#error "telemetry schema does not fit the UART, lower RATE_x or raise DEPTH_x"
+#endif
+
+//used constants for the run statistics
+//error = right - target [ADC code], histogram bins are STATS_BIN_WIDTH wide around 0,
+//  the outer bins also collect everything beyond them
+#define STATS_BINS          16
+#define STATS_BIN_WIDTH     128
+#define STATS_TICK_HZ       (CONTROL_RATE_HZ / CONTROL_DIVIDER) //PID() calls per second
+
+//used constants for the maze map, built from SHARP (junction) and UTURN (dead end)
+#define MAP_NODES           64      //start + junctions + dead ends + finish
+#define MAP_RETURN_SLACK    150     //back at the junction within this [% of the dead-end leg]
+#define MAP_PASS_TICKS      (STATS_TICK_HZ / 4) //drive straight this long past an opening
+#define NODE_START          0
+#define NODE_JUNCTION       1
+#define NODE_DEAD_END       2
+#define NODE_FINISH         3
+
+//DIRECTION channel bits, set = wheel forward
+#define DIRECTION_LEFT      0x01
+#define DIRECTION_RIGHT     0x02
+
+//used constants for the wall-distance estimator (Kalman filter)
+#define USE_ESTIMATOR       0       //1 = PID runs on filtered estimates, 0 = raw ADC
+                                    //  (as raced, the filter is not tuned on the robot)
+#define SENSE_PERIOD        (CONTROL_PERIOD * SENSE_DIVIDER) //estimator step [s]
+
+//used constants for the wheel encoders (USE_QEI), speeds and gains are in the profile
+#define QEI_LEFT_BASE       QEI0_BASE //PhA0 PD6, PhB0 PD7 (locked NMI pin)
+#define QEI_RIGHT_BASE      QEI1_BASE //PhA1 PC5, PhB1 PC6, swapped: forward counts up
+
+//used constants for the reflectance array (USE_LINE_ARRAY), element i on pin FIRST + i
+#define LINE_ARRAY_BASE     GPIO_PORTA_BASE
+#define LINE_ARRAY_FIRST_PIN 2      //PA2 = element 0 (left) .. PA5 (right)
+#define LINE_ARRAY_PINS     (LINE_ARRAY_MASK << LINE_ARRAY_FIRST_PIN)
+#if LINE_ARRAY_FIRST_PIN + LINE_ARRAY_SIZE > 8
+#error "the reflectance array does not fit one GPIO port"
+#endif
+#define HEADING_LIMIT       0.8f    //max heading relative to the wall [rad]
+#define Q_OFFSET            1000.0f //process noise: lateral offset [mm^2/s]
+#define Q_HEADING           0.2f    //process noise: heading [rad^2/s]
+#define Q_FRONT             2000.0f //process noise: front distance [mm^2/s]
+#define R_RIGHT             100.0f  //measurement noise: right sensor [mm^2]
+#define R_FRONT             200.0f  //measurement noise: front sensor [mm^2]
+#define GATE_SIGMA          3.0f    //innovations beyond this are outliers
+#define GATE_RESET_COUNT    2       //consecutive outliers before a re-initialize
 
 /*
  *************************************************************************************
@@ -101,49 +342,246 @@ char command[2] = "  "; //2-char command array
  */
 uint32_t rightSensorValue = 0; //right distance sensor ADC values
 uint32_t frontSensorValue = 0; //right distance sensor ADC values
+uint32_t leftSensorValue = 0;       //USE_LEFT_SENSOR: left distance sensor ADC value
+uint32_t adcSumRight = 0;           //ADC_PWM_TRIGGER: sums of the current window
+uint32_t adcSumFront = 0;
+uint32_t adcSumLeft = 0;
+uint32_t adcPeriods = 0;            //PWM periods in the current window
+uint32_t adcOverflows = 0;          //SS0 FIFO overflows, a window was thrown away
+uint32_t sampleCompare = 0;         //generator 2 compare last written, ADC trigger point
 
 /*
  *************************************************************************************
- * PWM VALUES
+ * PID VALUES
  *************************************************************************************
  */
-volatile uint32_t PWM_CLOCK, PWM_LOAD;
+int lastErrorRight = 0;             //error of the previous tick, for the D term
+volatile float pidRight;
+const SpeedConfig speedConfigs[ZONES] = ZONE_SPEED_CONFIGS; //planner and gains per ZONE_*
+volatile uint32_t speedZone = ZONE_NORMAL; //set by course markers
+SpeedState speedState = { 100.0f, 0 };
+volatile float speedPercent = 100.0f; //cruise duties x this [%], set by planSpeed()
+int wallMode = WALL_RIGHT;          //USE_LEFT_SENSOR: WALL_* controlGroup() picked
+uint32_t centeredTicks = 0;         //PID() ticks in WALL_CENTER this run
 
 /*
  *************************************************************************************
- * PID VALUES
+ * ACTUATORS
  *************************************************************************************
  */
-volatile float proportionalRight;
-volatile float lastProportionalRight;
-volatile float integralRight = 0;
-volatile float derivativeRight;
-volatile float pidRight;
+uint16_t pwmCompare[2][DUTY_MAX + 1]; //left, right: duty [1/DUTY_ONE %] -> compare << DITHER_BITS
+uint32_t compareShadow[2];          //left, right compare values last written (ditherISR() target)
+uint32_t ditherError[2];            //PWM_DITHER: left, right sigma-delta remainders
+volatile uint32_t motorMode;        //MOTOR_* the driver is in
+volatile int stopLatch = 0;         //1 from the finish brake until startRun()
+int stopTicks = 0;                  //stopBeforeReverse() state
+volatile uint32_t pidMode = MOTOR_DRIVE; //MOTOR_* PID() asked for on its last tick
+uint32_t phaseShadow;               //DIRECTION_LEFT | DIRECTION_RIGHT set = forward
+uint32_t ledShadow = 0xFF;          //PortF LED pins last written, 0xFF = not written yet
+uint32_t actuatorWrites = 0;        //register writes by driveMotors()
+uint32_t actuatorSkips = 0;         //ticks where nothing changed
+volatile int branch = BRANCH_NONE; //BRANCH_* taken on the last PID() tick
+
+/*
+ *************************************************************************************
+ * WHEEL VALUES (USE_QEI)
+ *************************************************************************************
+ */
+const WheelConfig wheelConfig = WHEEL_CONFIG; //inner loop gains from the profile
+WheelState wheels[2];               //left, right: speed, odometry and loop integral
+volatile float wheelTarget[2];      //left, right speeds PID() asked for [mm/s]
+
+/*
+ *************************************************************************************
+ * BATTERY VALUES (USE_BATTERY_COMP)
+ *************************************************************************************
+ */
+BatteryState battery = { 0.0f, 1.0f }; //filtered pack voltage and the duty scale
+uint32_t batteryCode = 0;           //last AIN8 reading
+
+/*
+ *************************************************************************************
+ * RATE GROUP VALUES
+ *************************************************************************************
+ */
+typedef struct {
+    const char *name;
+    void (*run)(void);
+    uint32_t divider;       //runs every divider base ticks
+    uint32_t budgetPercent; //share of its period it may use
+    uint32_t budget;        //same budget in CPU cycles, set by initRateGroups()
+    uint32_t period;        //divider base ticks in CPU cycles, set by initRateGroups()
+    uint32_t cyclesWorst;   //longest run [CPU cycles]
+    uint32_t overruns;      //runs longer than budget
+    uint32_t deadlineMisses;//released late or ran past the next release
+    uint32_t lastStart;     //cycle count at the previous run
+    uint32_t runs;
+} RateGroup;
+
+void senseGroup(void);
+void controlGroup(void);
+void batteryGroup(void);
+
+RateGroup rateGroups[RATE_GROUPS] = {
+    { "SENSE",   senseGroup,   SENSE_DIVIDER,   SENSE_BUDGET,   0, 0, 0, 0, 0, 0, 0 },
+    { "CONTROL", controlGroup, CONTROL_DIVIDER, CONTROL_BUDGET, 0, 0, 0, 0, 0, 0, 0 },
+#if USE_BATTERY_COMP
+    { "BATTERY", batteryGroup, BATTERY_GROUP_DIVIDER, BATTERY_BUDGET, 0, 0, 0, 0, 0, 0, 0 },
+#endif
+};
+uint32_t rateTick = 0;              //base ticks since start
+uint32_t tickCyclesWorst = 0;       //longest base tick [CPU cycles]
+uint32_t tickCyclesTotal = 0;       //sum of base tick cycles (for the average)
+uint32_t tickCount = 0;
+
+/*
+ *************************************************************************************
+ * CPU MONITOR VALUES
+ *************************************************************************************
+ */
+CpuMonitor cpu;                     //idle cycles and load over 1 second windows
+char console[3] = "  ";             //2-char command typed while running
+
+/*
+ *************************************************************************************
+ * ESTIMATOR VALUES
+ *************************************************************************************
+ */
+volatile float wallOffset = 0;      //estimated lateral distance to the right wall [mm]
+volatile float wallHeading = 0;     //estimated heading relative to the wall [rad]
+volatile float frontDistance = 0;   //estimated distance to the wall ahead [mm]
+float offsetCov[2][2];              //covariance of (wallOffset, wallHeading)
+float frontCov;                     //variance of frontDistance
+int rightOutliers = 0;              //consecutive gated right sensor readings
+int frontOutliers = 0;              //consecutive gated front sensor readings
+int estimatorReady = 0;             //0 until the first readings initialize the filter
+uint32_t estimatedRightValue = 0;   //estimates converted back to ADC codes for PID()
+uint32_t estimatedFrontValue = 0;
+int commandLeft = PWM_ADJUST * DUTY_ONE; //last commanded duty [1/DUTY_ONE %], negative = reverse
+int commandRight = PWM_ADJUST * DUTY_ONE;
 
 /*
  *************************************************************************************
  * LIGHT SENSOR VALUES
  *************************************************************************************
  */
-int blkLineCounter = 0;
+BarcodeState barcode;               //decodeBarcode() state, bar and gap widths
+uint32_t markerCounts[BARCODE_CODES]; //marker codes read this run
 int readData = 1; //robot should read data on the first pass of thin line
+volatile uint32_t lightValue = 0; //last decay count (LIGHT channel)
+uint32_t lineDecays[LINE_ARRAY_SIZE]; //USE_LINE_ARRAY: decay count of every element
+int lineFound = 0;                  //USE_LINE_ARRAY: a line was under the array
+int linePos = 0;                    //where [1/LINE_POSITION_ONE pitch], negative = left
+uint32_t lineReads = 0;             //array reads since start
+LightCalibration lightCal;          //black threshold and levels, learned with USE_LIGHT_CAL
 
 /*
  *************************************************************************************
- * PING PONG BUFFER VALUES
+ * TELEMETRY VALUES
  *************************************************************************************
  */
-volatile int buffer[BUFFER_SIZE];
-volatile int buffer_2[BUFFER_SIZE];
-volatile int temp_buffer[BUFFER_SIZE];
-signed int error = 0;
-int i = 0;
-int j = 0;
-int k = 0;
-int m = 0;
-int swap = 0;
+typedef struct {
+    uint32_t type;              //TELEMETRY_START, _SNAPSHOT, _STOP or _FINISH
+    int32_t values[CHANNELS];   //indexed by CHANNEL_*, snapshots only
+} TelemetryMsg;
+
+typedef struct {
+    const char *name;
+    const char *format;     //UARTprintf() format of one text sample
+    uint32_t every;         //keep one snapshot in every
+    uint32_t depth;         //samples per line
+} TelemetryChannel;
+
+const TelemetryChannel telemetryChannels[CHANNELS] = {
+    { "ERROR",     "%X, ", SNAPSHOT_HZ / RATE_ERROR,     DEPTH_ERROR },
+    { "RIGHT",     "%d, ", SNAPSHOT_HZ / RATE_RIGHT,     DEPTH_RIGHT },
+    { "FRONT",     "%d, ", SNAPSHOT_HZ / RATE_FRONT,     DEPTH_FRONT },
+    { "PID",       "%d, ", SNAPSHOT_HZ / RATE_PID,       DEPTH_PID },
+    { "BRANCH",    "%d, ", SNAPSHOT_HZ / RATE_BRANCH,    DEPTH_BRANCH },
+    { "DUTY_LEFT", "%d, ", SNAPSHOT_HZ / RATE_DUTY,      DEPTH_DUTY },
+    { "DUTY_RIGHT","%d, ", SNAPSHOT_HZ / RATE_DUTY,      DEPTH_DUTY },
+    { "DIRECTION", "%d, ", SNAPSHOT_HZ / RATE_DIRECTION, DEPTH_DIRECTION },
+    { "LIGHT",     "%d, ", SNAPSHOT_HZ / RATE_LIGHT,     DEPTH_LIGHT },
+};
+
+volatile int streaming = 0;         //1 between the thin lines, PID() posts snapshots
+uint32_t snapshotCount = 0;         //snapshots since START, owned by telemetryTask()
+uint32_t channelCount[CHANNELS];    //samples waiting per channel
+#if TELEMETRY_COMPRESSED
+CodecFrame channelFrames[CHANNELS]; //samples are compressed as they arrive
+#else
+int32_t channelValues[CHANNELS][CODEC_MAX_SAMPLES];
+#endif
 int error_count = 1;
-int bufferCt = 0;
+uint32_t telemetryDropped = 0;      //messages lost to a full mailbox
+uint32_t telemetryCyclesWorst = 0;  //longest message handled by telemetryTask()
+
+/*
+ *************************************************************************************
+ * RUN STATISTICS VALUES
+ *************************************************************************************
+ */
+typedef struct {
+    uint32_t count;                 //PID() ticks
+    float mean;                     //Welford running mean of the error
+    float m2;                       //Welford sum of squared deviations
+    int32_t min;
+    int32_t max;
+    uint32_t histogram[STATS_BINS];
+    uint32_t branchTicks[BRANCHES]; //ticks spent in each BRANCH_*
+    uint32_t uturns;                //entries into BRANCH_UTURN
+    int lastBranch;
+} RunStats;
+
+const char *branchNames[BRANCHES] = {
+    "NONE", "UTURN", "LEFT", "RIGHT", "SHARP", "STRAIGHT", "SPECIAL"
+};
+
+RunStats segmentStats;              //between the thin lines, updated by PID()
+RunStats runStats;                  //GO to the thick line, updated by PID()
+int segmentOpen = 0;                //PID()'s copy of streaming, to catch the start
+
+/*
+ *************************************************************************************
+ * BRANCH COVERAGE VALUES
+ *************************************************************************************
+ */
+uint32_t branchVisits[BRANCHES];            //entries into each BRANCH_*, GO to finish
+uint32_t branchDwellLongest[BRANCHES];      //longest single visit [PID() ticks]
+uint32_t branchTransitions[BRANCHES][BRANCHES]; //[from][to], changes only
+uint32_t branchDwell = 0;                   //ticks in the current visit
+int branchLast = BRANCH_NONE;
+
+/*
+ *************************************************************************************
+ * MAZE MAP VALUES
+ *************************************************************************************
+ */
+typedef struct {
+    uint8_t type;           //NODE_*
+    uint8_t parent;         //index in mapNodes[]
+    uint8_t exit;           //exit of the parent that leads here, 1 = its right opening
+    uint8_t exitsTaken;     //exits of this node tried so far
+    uint32_t edgeTicks;     //PID() ticks from the parent
+} MapNode;
+
+const char *nodeNames[] = { "START", "JUNCTION", "DEAD END", "FINISH" };
+
+MapNode mapNodes[MAP_NODES];        //tree, mapNodes[0] is the start
+uint32_t mapCount = 0;
+uint32_t mapCurrent = 0;            //last junction the robot went through
+uint32_t mapTicks = 0;              //PID() ticks since GO
+uint32_t mapEventTick = 0;          //mapTicks at mapCurrent
+int mapReturning = 0;               //1 from a U-turn until back at mapCurrent
+uint32_t mapReturnTick = 0;         //expected mapTicks back at mapCurrent
+uint32_t mapReturnDeadline = 0;
+uint32_t mapFirstRunTicks = 0;
+uint8_t mapPlan[MAP_NODES];         //per junction on the path: 1 = take the opening
+uint32_t mapPlanLength = 0;
+uint32_t mapPlanStep = 0;
+int mapShortcut = 0;                //1 = the run follows mapPlan[] instead of mapping
+uint32_t mapPassTicks = 0;          //>0 while driving past an opening
+volatile int runActive = 0;         //1 from GO to the thick line
 
 /*
  *************************************************************************************
@@ -154,17 +592,73 @@ void ConfigurePeripherals(void);
 void ConfigureUART(void);
 void ConfigureADC(void);
 void ConfigurePWM(void);
+void initActuators(void);
+void configError(const char *what);
 void PID(int RightValue, int FrontValue);
 void prepPID(void);
-void OutputBuffer(void);
+void controlISR(UArg arg);
+void ditherISR(UArg arg);
+void runRateGroups(void);
+void initRateGroups(void);
+void initCpuMonitor(void);
+uint32_t readCycles(void);
+void cpuLoadIdle(void);
+void pollConsole(void);
+void printCpuMonitor(void);
+void resetStats(RunStats *stats);
+void updateStats(RunStats *stats, int32_t error, int taken);
+void printStats(const char *label, const RunStats *stats);
+void recordBranch(int taken);
+void printBranches(void);
+void resetMap(void);
+void addMapNode(uint8_t type, uint32_t edgeTicks);
+void mapBackAtJunction(uint32_t tick);
+void updateMap(int taken);
+int takeSharp(void);
+void finishMap(void);
+void solveMap(uint32_t finish);
+void printMap(void);
+void startRun(void);
+void stopControl(void);
+void printRateGroups(void);
+void ConfigureControlTimer(void);
+void ConfigureSampleTrigger(void);
+void ConfigureQEI(void);
+int32_t readQei(uint32_t wheel);
+void wheelISR(UArg arg);
+uint32_t distanceToADC(float distance);
+void resetEstimator(float rDistance, float fDistance);
+void updateEstimator(uint32_t rValue, uint32_t fValue);
+void telemetryTask(UArg arg0, UArg arg1);
+void storeSnapshot(const TelemetryMsg *msg);
+void flushChannel(uint32_t channel, const char *label);
+void sendFrame(CodecFrame *frame);
+void postTelemetry(uint32_t type);
+void postMessage(TelemetryMsg *msg);
+void recordTelemetryCycles(uint32_t cycles);
+void readLineArray(uint32_t decays[]);
+void toggleReading(void);
+void runMarker(uint32_t code);
 void lightSensorCalculation(void);
-void switchBuffers(void);
 
 /*
  *************************************************************************************
  * INITIALIZE EVERYTHING
  *************************************************************************************
  */
+    /*
+     *********************************************************************************
+     * A build that does not match the hardware it runs on: motors off, report on
+     *  the console and stop. Stays in release builds, unlike ASSERT().
+     *********************************************************************************
+     */
+void configError(const char *what) {
+    PWMOutputState(PWM1_BASE, PWM_OUT_2_BIT | PWM_OUT_3_BIT, false);
+    UARTprintf("CONFIG ERROR: %s, halted\n", what);
+    while (true) {
+    }
+}
+
 void ConfigurePeripherals(void) {
 
     // Set system clock
@@ -181,6 +675,13 @@ void ConfigurePeripherals(void) {
     ConfigureUART();
     ConfigurePWM();
     ConfigureADC();
+#if USE_QEI
+    ConfigureQEI();
+#endif
+#if USE_LINE_ARRAY
+    // Reflectance array, lightSensorCalculation() switches the pins every read
+    SysCtlPeripheralEnable(SYSCTL_PERIPH_GPIOA);
+#endif
 }
 
 /*
@@ -228,6 +729,10 @@ void ConfigureADC(void) {
 
     // Configure PortE pins 2 & 3 for ADC usage | Pin3 = right sensor Pin2 = front sensor
     GPIOPinTypeADC(GPIO_PORTE_BASE, GPIO_PIN_3 | GPIO_PIN_2);
+#if USE_LEFT_SENSOR
+    // Pin4 = left sensor (AIN9)
+    GPIOPinTypeADC(GPIO_PORTE_BASE, GPIO_PIN_4);
+#endif
 
     // Disable sequencers to ensure safe reconfiguration of them
     ADCSequenceDisable(ADC0_BASE, SEQ1); //disable sequence 1
@@ -244,9 +749,17 @@ void ConfigureADC(void) {
                          PRI_1);
 
     // Configuring sequence steps for sequence 1
+#if USE_LEFT_SENSOR
+    // Step 0: sample right sensor
+    // Step 1: sample left sensor, end of sequence
+    ADCSequenceStepConfigure(ADC0_BASE, SEQ1, STEP_0, ADC_CTL_CH0);
+    ADCSequenceStepConfigure(ADC0_BASE, SEQ1, STEP_0 + 1,
+                             (ADC_CTL_CH9 | ADC_CTL_END));
+#else
     // Step 0: sample right sensor, end of sequence
     ADCSequenceStepConfigure(ADC0_BASE, SEQ1, STEP_0,
                              (ADC_CTL_CH0 | ADC_CTL_END));
+#endif
 
     // Configuring sequence steps for sequence 2
     // Step 0: sample front sensor, end of sequence
@@ -256,6 +769,79 @@ void ConfigureADC(void) {
     // Re-enable configured sequences
     ADCSequenceEnable(ADC0_BASE, SEQ1);
     ADCSequenceEnable(ADC0_BASE, SEQ2);
+
+#if USE_BATTERY_COMP
+    // SS3 - sample the battery divider on PE5 (AIN8) | priority = 3
+    // Step 0: battery, raw interrupt flag for batteryGroup(), end of sequence
+    GPIOPinTypeADC(GPIO_PORTE_BASE, GPIO_PIN_5);
+    ADCSequenceConfigure(ADC0_BASE, SEQ3, ADC_TRIGGER_PROCESSOR, PRI_3);
+    ADCSequenceStepConfigure(ADC0_BASE, SEQ3, STEP_0,
+                             (ADC_CTL_CH8 | ADC_CTL_IE | ADC_CTL_END));
+    ADCSequenceEnable(ADC0_BASE, SEQ3);
+    ADCIntClear(ADC0_BASE, SEQ3);
+    ADCProcessorTrigger(ADC0_BASE, SEQ3);
+#endif
+
+#if ADC_PWM_TRIGGER
+    // SS0 - sample both sensors on the PWM1 generator 2 trigger | priority = 0
+    // Step 0: right sensor
+    // Step 1: front sensor, interrupt (controlISR), end of sequence
+    ADCSequenceDisable(ADC0_BASE, SEQ0);
+    ADCSequenceConfigure(ADC0_BASE, SEQ0, ADC_TRIGGER_PWM2 | ADC_TRIGGER_PWM_MOD1, PRI_0);
+    ADCSequenceStepConfigure(ADC0_BASE, SEQ0, STEP_0, ADC_CTL_CH0);
+#if USE_LEFT_SENSOR
+    // Step 2: left sensor takes over the interrupt and the end of sequence
+    ADCSequenceStepConfigure(ADC0_BASE, SEQ0, STEP_0 + 1, ADC_CTL_CH1);
+    ADCSequenceStepConfigure(ADC0_BASE, SEQ0, STEP_0 + 2,
+                             (ADC_CTL_CH9 | ADC_CTL_IE | ADC_CTL_END));
+#else
+    ADCSequenceStepConfigure(ADC0_BASE, SEQ0, STEP_0 + 1,
+                             (ADC_CTL_CH1 | ADC_CTL_IE | ADC_CTL_END));
+#endif
+    ADCSequenceEnable(ADC0_BASE, SEQ0);
+    ADCIntClear(ADC0_BASE, SEQ0);
+    ADCIntEnable(ADC0_BASE, SEQ0);
+
+    ConfigureSampleTrigger();
+#elif HIGH_RATE_MODE
+    // SS0 - sample both sensors on the Timer1 trigger | priority = 0
+    // Step 0: right sensor
+    // Step 1: front sensor, interrupt (controlISR), end of sequence
+    ADCSequenceDisable(ADC0_BASE, SEQ0);
+    ADCSequenceConfigure(ADC0_BASE, SEQ0, ADC_TRIGGER_TIMER, PRI_0);
+    ADCSequenceStepConfigure(ADC0_BASE, SEQ0, STEP_0, ADC_CTL_CH0);
+#if USE_LEFT_SENSOR
+    // Step 2: left sensor takes over the interrupt and the end of sequence
+    ADCSequenceStepConfigure(ADC0_BASE, SEQ0, STEP_0 + 1, ADC_CTL_CH1);
+    ADCSequenceStepConfigure(ADC0_BASE, SEQ0, STEP_0 + 2,
+                             (ADC_CTL_CH9 | ADC_CTL_IE | ADC_CTL_END));
+#else
+    ADCSequenceStepConfigure(ADC0_BASE, SEQ0, STEP_0 + 1,
+                             (ADC_CTL_CH1 | ADC_CTL_IE | ADC_CTL_END));
+#endif
+    ADCSequenceEnable(ADC0_BASE, SEQ0);
+    ADCIntClear(ADC0_BASE, SEQ0);
+    ADCIntEnable(ADC0_BASE, SEQ0);
+
+    ConfigureControlTimer();
+#endif
+}
+
+/*
+ *************************************************************************************
+ * CONTROL TIMER CONFIG (HIGH_RATE_MODE)
+ *************************************************************************************
+ */
+// Timer1A triggers ADC0 SS0 at CONTROL_RATE_HZ, started by the GO command
+void ConfigureControlTimer(void) {
+
+    SysCtlPeripheralEnable(SYSCTL_PERIPH_TIMER1);
+
+    TimerConfigure(TIMER1_BASE, TIMER_CFG_PERIODIC);
+    TimerLoadSet(TIMER1_BASE, TIMER_A, (SysCtlClockGet() / CONTROL_RATE_HZ) - 1);
+
+    // Timer output goes to the ADC instead of an interrupt
+    TimerControlTrigger(TIMER1_BASE, TIMER_A, true);
 }
 
 /*
@@ -266,8 +852,8 @@ void ConfigureADC(void) {
 // Enabling PWM peripheral
 void ConfigurePWM(void)
 {
-    // Set the PWM module's clock divider
-    SysCtlPWMClockSet(SYSCTL_PWMDIV_64); //16[MHz]/64
+    // Set the PWM module's clock divider, /64 or the one PWM_HIGH_RES picked
+    SysCtlPWMClockSet(PWM_DIV_CONFIG);
 
     // Enable the clock for PWM1 and PortA, PortB, PortE
     SysCtlPeripheralEnable(SYSCTL_PERIPH_GPIOA);
@@ -288,436 +874,2014 @@ void ConfigurePWM(void)
     GPIOPinTypePWM(GPIO_PORTA_BASE, GPIO_PIN_6 | GPIO_PIN_7);
 
     // Configure M1PWM0 for count down mode
-    PWMGenConfigure(PWM1_BASE, PWM_GEN_1, PWM_GEN_MODE_DOWN);
+    // Compare updates wait for PWMSyncUpdate() so both motors change on the same period
+    PWMGenConfigure(PWM1_BASE, PWM_GEN_1, PWM_GEN_MODE_DOWN | PWM_GEN_MODE_SYNC);
 
-    // Calculate the PWM clock and load values
-    PWM_CLOCK = SysCtlClockGet() / 64;
-    PWM_LOAD = (PWM_CLOCK / PWM_FREQ) - 1;
+    // PWM_LOAD is computed at compile time from SYSTEM_CLOCK_HZ (robot_profile.h)
+    if (SysCtlClockGet() != SYSTEM_CLOCK_HZ) {
+        configError("SysCtlClockGet() differs from SYSTEM_CLOCK_HZ");
+    }
 
     // Set the period of the PWM generator
     PWMGenPeriodSet(PWM1_BASE, PWM_GEN_1, PWM_LOAD);
 
     // Specify the duty cycle for the PWM signal
-    PWMPulseWidthSet(PWM1_BASE, PWM_OUT_2, PWM_ADJUST * PWM_LOAD / 100); //left motor
-    PWMPulseWidthSet(PWM1_BASE, PWM_OUT_3, PWM_ADJUST * PWM_LOAD / 100); //right motor
+    PWMPulseWidthSet(PWM1_BASE, PWM_OUT_2, DUTY_COUNT(PWM_ADJUST)); //left motor
+    PWMPulseWidthSet(PWM1_BASE, PWM_OUT_3, DUTY_COUNT(PWM_ADJUST)); //right motor
+
+    // Enable the timer/counter for M1PWM0, then apply the period and duties
+    PWMGenEnable(PWM1_BASE, PWM_GEN_1);
+    PWMSyncUpdate(PWM1_BASE, PWM_GEN_1_BIT);
 
     // Enable PWM output
     PWMOutputState(PWM1_BASE, PWM_OUT_2_BIT | PWM_OUT_3_BIT, true);
 
-    // Enable the timer/counter for M1PWM0
-    PWMGenEnable(PWM1_BASE, PWM_GEN_1);
+    initActuators();
 
+#if PWM_DITHER
+    // ditherISR() at the start of every period
+    PWMGenIntTrigEnable(PWM1_BASE, PWM_GEN_1, PWM_INT_CNT_LOAD);
+    PWMIntEnable(PWM1_BASE, PWM_INT_GEN_1);
+#endif
 }
 
 /*
  *************************************************************************************
- * CLOCK FUNCTION 1 - OUTPUT BUFFER TO TERMINAL (PC)
+ * ACTUATORS
  *************************************************************************************
  */
     /*
      *********************************************************************************
-     *  Print the error values to the terminal (PuTTy)
-     *
-     *  A variable "swap" ensures that ping-pong mechanism is followed.
+     *  Shadow of the motor and LED outputs, so a tick only touches what changed.
      *
-     *  buffer[] and buffer_2[] prints out alternate error values.
+     *  Duties go through pwmCompare[] instead of DUTY_COUNT(), no multiply and
+     *      divide per tick. The values are what PWMPulseWidthSet() would write in
+     *          count down mode: LOAD register - width, with DITHER_BITS of
+     *              fraction. PWMGenPeriodSet() wrote PWM_LOAD - 1 there.
      *
-     *  Buffer_Clk trigger this interrupt every 2 seconds.
+     *  Each motor has its own table with its curve from motor_calibration.h
+     *      folded in: a commanded duty c runs the motor at
+     *          deadband + c * MOTOR_CAL_REFERENCE / slope [%]
+     *      so both wheels turn at the same speed for the same command. 0 stays 0.
+     *      Uncalibrated, the curve is 1:1.
      *
-     *  When the UARTBusy function is 0 or NULL
-     *      it implies that values are being printed onto PuTTY
-     *          while the other buffer is being filled.
+     *  Call after ConfigurePWM() has set both motors forward at PWM_ADJUST.
      *********************************************************************************
      */
-void OutputBuffer(void) {
-
-
-    if (swap == 0) {
-
-        // Reset LEDs
-        GPIOPinWrite(GPIO_PORTF_BASE, GPIO_PIN_1|GPIO_PIN_2|GPIO_PIN_3, 0);
-        // Constant green LED to signal that it's transmitting to PC
-        GPIOPinWrite(GPIO_PORTF_BASE, GPIO_PIN_3, GPIO_PIN_3);
-
-        // Transmitting buffer to PC in specified format
-        UARTprintf(": ");
-        for (j = 0; j < BUFFER_SIZE; ++j) {
-            UARTprintf("%X, ", buffer[j]);
-
-            //If UART is busy, store values into second buffer
-            if(UARTBusy(UART1_BASE)) {
-                buffer_2[j] = temp_buffer[j];
+void initActuators(void) {
+    static const float slope[2] = { MOTOR_CAL_SLOPE_L, MOTOR_CAL_SLOPE_R };
+    static const float deadband[2] = { MOTOR_CAL_DEADBAND_L, MOTOR_CAL_DEADBAND_R };
+    uint32_t motor, duty, motorDuty, width;
+    float percent;
+
+    for (motor = 0; motor < 2; ++motor) {
+        for (duty = 0; duty <= DUTY_MAX; ++duty) {
+            percent = 0.0f;
+            if (duty > 0) {
+                percent = deadband[motor] +
+                          (float)duty / DUTY_ONE * MOTOR_CAL_REFERENCE / slope[motor];
+            }
+            motorDuty = (uint32_t)(percent * DUTY_ONE + 0.5f);
+            if (motorDuty > DUTY_MAX) {
+                motorDuty = DUTY_MAX;
             }
+            width = motorDuty * (PWM_LOAD << DITHER_BITS) / (100 * DUTY_ONE);
+            if (width > (PWM_LOAD_REG << DITHER_BITS)) {
+                width = PWM_LOAD_REG << DITHER_BITS; //short periods: 99% rounds past LOAD
+            }
+            pwmCompare[motor][duty] = (PWM_LOAD_REG << DITHER_BITS) - width;
+        }
+        // Same pin states as PWMPulseWidthSet(DUTY_COUNT()) at both ends: 0 compares
+        //  at the reload like a zero width, 99% (uncalibrated) within one count
+        if ((pwmCompare[motor][0] != (PWM_LOAD_REG << DITHER_BITS)) ||
+            (!MOTOR_CAL_VALID &&
+             (abs((int)pwmCompare[motor][DUTY_MAX] -
+                  (int)((PWM_LOAD_REG - DUTY_COUNT(99)) << DITHER_BITS)) >= (1 << DITHER_BITS)))) {
+            configError("pwmCompare[] ends differ from PWMPulseWidthSet()");
         }
-        UARTprintf("\r\n\n");
-        // End of transmission
-
-        //Post to Buffer_SWI which calls switchBuffers function
-        Swi_post(Buffer_SWI);
     }
+    compareShadow[0] = pwmCompare[0][PWM_ADJUST * DUTY_ONE];
+    compareShadow[1] = pwmCompare[1][PWM_ADJUST * DUTY_ONE];
+    // PWMPulseWidthSet() knew no curve, start on the calibrated compares
+    HWREG(PWM1_BASE + PWM_O_1_CMPA) = compareShadow[0] >> DITHER_BITS;
+    HWREG(PWM1_BASE + PWM_O_1_CMPB) = compareShadow[1] >> DITHER_BITS;
+    HWREG(PWM1_BASE + PWM_O_CTL) = PWM_CTL_GLOBALSYNC1;
+    ditherError[0] = 0;
+    ditherError[1] = 0;
+    phaseShadow = DIRECTION_LEFT | DIRECTION_RIGHT;
+    motorMode = MOTOR_DRIVE;
+}
 
-    else if (swap == 1) {
-        // Reset
-        GPIOPinWrite(GPIO_PORTF_BASE, GPIO_PIN_1|GPIO_PIN_2|GPIO_PIN_3, 0);
-        // Constant green LED to signal that it's transmitting to PC
-        GPIOPinWrite(GPIO_PORTF_BASE, GPIO_PIN_3, GPIO_PIN_3);
+    /*
+     *********************************************************************************
+     *  Counting down from LOAD (PWM_LOAD - 1) to 0, an output rises at the reload
+     *      and falls at its compare, so one period of PWM_LOAD counts has edges
+     *          at 0 (reload) and LOAD - compare of each motor [counts after the
+     *              reload]. Returns the compare in the middle of the longest gap,
+     *                  the furthest point from any switching edge.
+     *********************************************************************************
+     */
+static inline uint32_t quietCompare(uint32_t compareLeft, uint32_t compareRight) {
+    uint32_t first = PWM_LOAD_REG - ((compareLeft > compareRight) ? compareLeft : compareRight);
+    uint32_t second = PWM_LOAD_REG - ((compareLeft > compareRight) ? compareRight : compareLeft);
+    uint32_t middle = first / 2;
+    uint32_t gap = first;
+
+    if (second - first > gap) {
+        gap = second - first;
+        middle = first + gap / 2;
+    }
+    if (PWM_LOAD - second > gap) {
+        middle = second + (PWM_LOAD - second) / 2;
+    }
+    return PWM_LOAD_REG - middle;
+}
 
-        // Transmitting buffer to PC in specified format
-        UARTprintf(": ");
-        for (j = 0; j < BUFFER_SIZE; ++j) {
-            UARTprintf("%X, ", buffer_2[j]);
+    /*
+     *********************************************************************************
+     *  Signed duties [%] to the phase pins and compare registers.
+     *
+     *  Phase pins go through the masked GPIODATA address, one store per pin
+     *      and no read-modify-write. Both compares are written first and then
+     *          released together with the global sync, so the motors change on the
+     *              same PWM period.
+     *
+     *  PID() (Swi) and wheelISR() (Hwi) call this and can be preempted by the
+     *      finish brake (light sensor Hwi). Leaving a brake or coast is checked
+     *          against stopLatch with interrupts off, so a tick that started
+     *              before the finish line cannot turn the outputs back on.
+     *********************************************************************************
+     */
+static inline void driveMotors(int left, int right) {
+    uint32_t phase, changed, compareLeft, compareRight;
+    UInt key;
+
+#if USE_BATTERY_COMP && !USE_QEI
+    // Same average motor voltage as on the pack the duties were tuned at. Open loop
+    //  only, wheelISR() already makes up for the pack and would be compensated twice
+    left = compensateDuty(&battery, left);
+    right = compensateDuty(&battery, right);
+#endif
+    phase = ((left >= 0) ? DIRECTION_LEFT : 0) | ((right >= 0) ? DIRECTION_RIGHT : 0);
+    changed = phase ^ phaseShadow;
+    compareLeft = pwmCompare[0][(left >= 0) ? left : -left];
+    compareRight = pwmCompare[1][(right >= 0) ? right : -right];
+
+    // Left motor on PE1, right motor on PB6, set = forward
+    if (changed & DIRECTION_LEFT) {
+        HWREG(GPIO_PORTE_BASE + GPIO_O_DATA + (GPIO_PIN_1 << 2)) =
+                (phase & DIRECTION_LEFT) ? GPIO_PIN_1 : 0;
+        ++actuatorWrites;
+    }
+    if (changed & DIRECTION_RIGHT) {
+        HWREG(GPIO_PORTB_BASE + GPIO_O_DATA + (GPIO_PIN_6 << 2)) =
+                (phase & DIRECTION_RIGHT) ? GPIO_PIN_6 : 0;
+        ++actuatorWrites;
+    }
+    phaseShadow = phase;
+
+    if (motorMode != MOTOR_DRIVE) {
+        // Back from a brake or coast: PHASE/ENABLE mode, outputs on
+        key = Hwi_disable();
+        if (stopLatch) {
+            // Stopped at the finish, only startRun() lets the motors go again
+            Hwi_restore(key);
+            return;
+        }
+        HWREG(GPIO_PORTB_BASE + GPIO_O_DATA + (GPIO_PIN_7 << 2)) = GPIO_PIN_7;
+        HWREG(PWM1_BASE + PWM_O_ENABLE) |= PWM_OUT_2_BIT | PWM_OUT_3_BIT;
+        motorMode = MOTOR_DRIVE;
+        Hwi_restore(key);
+        actuatorWrites += 2;
+        changed = 1;
+    }
 
-            //If UART is busy, store values into first buffer
-            if(UARTBusy(UART1_BASE)) {
-                buffer[j] = temp_buffer[j];
-            }
+    if ((compareLeft == compareShadow[0]) && (compareRight == compareShadow[1])) {
+        if (changed == 0) {
+            ++actuatorSkips;
         }
-        UARTprintf("\r\n\n");
-        // End of transmission
+        return;
+    }
+#if PWM_DITHER
+    // ditherISR() writes the compares every period, only the targets change here
+    compareShadow[0] = compareLeft;
+    compareShadow[1] = compareRight;
+#else
+    if (compareLeft != compareShadow[0]) {
+        HWREG(PWM1_BASE + PWM_O_1_CMPA) = compareLeft; //left motor, M1PWM2
+        compareShadow[0] = compareLeft;
+        ++actuatorWrites;
+    }
+    if (compareRight != compareShadow[1]) {
+        HWREG(PWM1_BASE + PWM_O_1_CMPB) = compareRight; //right motor, M1PWM3
+        compareShadow[1] = compareRight;
+        ++actuatorWrites;
+    }
+#endif
+#if ADC_PWM_TRIGGER
+    // Follow the edges with the ADC trigger, same sync as the motors
+    compareLeft = quietCompare(compareLeft >> DITHER_BITS, compareRight >> DITHER_BITS);
+    if (compareLeft != sampleCompare) {
+        HWREG(PWM1_BASE + PWM_O_2_CMPA) = compareLeft;
+        sampleCompare = compareLeft;
+        ++actuatorWrites;
+    }
+#endif
+#if !PWM_DITHER
+    HWREG(PWM1_BASE + PWM_O_CTL) = PWM_SYNC_BITS;
+    ++actuatorWrites;
+#endif
+}
+
+    /*
+     *********************************************************************************
+     *  Brake: PHASE/ENABLE mode with both ENABLE inputs low, the driver shorts
+     *      each motor through its low side and the back EMF stops it.
+     *  Coast: PB7 low puts the driver in IN/IN mode, with the PWM and phase
+     *      pins low both bridges float and the robot rolls out.
+     *  Either holds until the next driveMotors(), which restores PHASE/ENABLE
+     *      mode. The first period after that may still run the old compares.
+     *  PWM_O_ENABLE is read-modify-written from Swi and Hwi callers, so it and
+     *      motorMode change together with interrupts off.
+     *********************************************************************************
+     */
+static inline void brakeMotors(void) {
+    UInt key = Hwi_disable();
 
-        //Post to Buffer_SWI which calls switchBuffers function
-        Swi_post(Buffer_SWI);
+    if (motorMode == MOTOR_BRAKE) {
+        Hwi_restore(key);
+        ++actuatorSkips;
+        return;
     }
+    if (motorMode == MOTOR_COAST) {
+        HWREG(GPIO_PORTB_BASE + GPIO_O_DATA + (GPIO_PIN_7 << 2)) = GPIO_PIN_7;
+        ++actuatorWrites;
+    }
+    HWREG(PWM1_BASE + PWM_O_ENABLE) &= ~(PWM_OUT_2_BIT | PWM_OUT_3_BIT);
+    motorMode = MOTOR_BRAKE;
+    Hwi_restore(key);
+    ++actuatorWrites;
+}
 
-    // Resets index to 0 for temp_buffer[] array in the PID function
-    i = 0;
+static inline void coastMotors(void) {
+    UInt key = Hwi_disable();
+
+    if (motorMode == MOTOR_COAST) {
+        Hwi_restore(key);
+        ++actuatorSkips;
+        return;
+    }
+    HWREG(PWM1_BASE + PWM_O_ENABLE) &= ~(PWM_OUT_2_BIT | PWM_OUT_3_BIT);
+    HWREG(GPIO_PORTE_BASE + GPIO_O_DATA + (GPIO_PIN_1 << 2)) = 0;
+    HWREG(GPIO_PORTB_BASE + GPIO_O_DATA + (GPIO_PIN_6 << 2)) = 0;
+    HWREG(GPIO_PORTB_BASE + GPIO_O_DATA + (GPIO_PIN_7 << 2)) = 0;
+    phaseShadow = 0;
+    motorMode = MOTOR_COAST;
+    Hwi_restore(key);
+    actuatorWrites += 4;
 }
 
 /*
  *************************************************************************************
- * SWI INTERRUPT FUNCTION - SWITCH BUFFERS
+ * HWI FUNCTION - PWM DITHER (PWM_DITHER)
  *************************************************************************************
  */
     /*
      *********************************************************************************
-     * A simple function that handles the ping-pong mechanic
-     *  which allows switch the active buffer.
+     *  Runs at the start of every PWM period. First order sigma-delta per motor:
+     *      the fraction of the target compare is added up and every time it
+     *          carries, this period gets one more count. Over 2^DITHER_BITS
+     *              periods the average compare is the target.
+     *
+     *  The writes take effect at the end of this period (global sync), the
+     *      same path driveMotors() takes without dithering.
      *********************************************************************************
      */
-void switchBuffers(void) {
-    // Use other buffer
-    if (swap == 0) {
-        swap = 1;
-    }
-    else if (swap == 1) {
-        swap = 0;
-    }
+void ditherISR(UArg arg) {
+    uint32_t left = compareShadow[0];
+    uint32_t right = compareShadow[1];
+
+    PWMGenIntClear(PWM1_BASE, PWM_GEN_1, PWM_INT_CNT_LOAD);
+
+    ditherError[0] += left & DITHER_MASK;
+    ditherError[1] += right & DITHER_MASK;
+    HWREG(PWM1_BASE + PWM_O_1_CMPA) = (left >> DITHER_BITS) + (ditherError[0] >> DITHER_BITS);
+    HWREG(PWM1_BASE + PWM_O_1_CMPB) = (right >> DITHER_BITS) + (ditherError[1] >> DITHER_BITS);
+    ditherError[0] &= DITHER_MASK;
+    ditherError[1] &= DITHER_MASK;
+    HWREG(PWM1_BASE + PWM_O_CTL) = PWM_SYNC_BITS;
 }
 
 /*
  *************************************************************************************
- * CLOCK FUNCTION 2 - GET ADC VALUES AND RUN PID
+ * SAMPLE TRIGGER CONFIG (ADC_PWM_TRIGGER)
  *************************************************************************************
  */
     /*
      *********************************************************************************
-     * PID_Clk triggers the ADC0_Base to acquire the ADC samples from the
-     *  front and right sensors.
-     *
-     * Runs every 50[ms].
-     *
-     * ADC values sent to PID function
+     *  Generator 2 has no pins, it only counts alongside generator 1 with the
+     *      same load. Its compare A (counting down) is the ADC trigger, moved by
+     *          driveMotors() to the middle of the longest gap between edges.
+     *  Call after ConfigurePWM().
      *********************************************************************************
      */
-void prepPID(void) {
-
-    // Trigger the sample sequence 1
-    ADCProcessorTrigger(ADC0_BASE, SEQ1);
-
-    // Get results from sample sequence 1
-    ADCSequenceDataGet(ADC0_BASE, SEQ1, &rightSensorValue);
-
-    // Trigger sample sequence 2
-    ADCProcessorTrigger(ADC0_BASE, SEQ2);
-
-    // Get results from sample sequence 2
-    ADCSequenceDataGet(ADC0_BASE, SEQ2, &frontSensorValue);
-
-    // Calls PID function to perform PID using the given sensor values
-    PID(rightSensorValue, frontSensorValue);
+void ConfigureSampleTrigger(void) {
+
+    PWMGenConfigure(PWM1_BASE, PWM_GEN_2, PWM_GEN_MODE_DOWN | PWM_GEN_MODE_SYNC);
+    PWMGenPeriodSet(PWM1_BASE, PWM_GEN_2, PWM_LOAD);
+    sampleCompare = quietCompare(compareShadow[0] >> DITHER_BITS, compareShadow[1] >> DITHER_BITS);
+    HWREG(PWM1_BASE + PWM_O_2_CMPA) = sampleCompare;
+    PWMGenIntTrigEnable(PWM1_BASE, PWM_GEN_2, PWM_TR_CNT_AD);
+
+    // Start generator 2 and reset both counters together so they stay in phase
+    PWMGenEnable(PWM1_BASE, PWM_GEN_2);
+    PWMSyncUpdate(PWM1_BASE, PWM_GEN_2_BIT);
+    PWMSyncTimeBase(PWM1_BASE, PWM_GEN_1_BIT | PWM_GEN_2_BIT);
 }
 
 /*
  *************************************************************************************
- * PID
+ * QEI CONFIG (USE_QEI)
  *************************************************************************************
  */
     /*
-     *  This function essentially follows a PID controller.
-     *      Gain values for the proportional, integral and
-     *          derivative terms are selected to tune the robot to follow the wall.
-     *
-     *  The proportional gain = 1/20
-     *  The integral gain = 1/10000
-     *  The differential gain = 3/2
-     *
-     *  The target value chosen is 2000.
-     *
-     *  The (current ADC values - target value) is defined as the error values
-     *      which will be stored in a buffer.
-     *
-     *  The ranges determine how close it is to the wall
-     *      and what actions must be taken to prevent the robot from crashing into the wall.
-     *
-     *  The error values are stored in the buffer which is used in the OutputBuffer()
+     *********************************************************************************
+     *  QEI0 counts the left wheel, QEI1 the right one, both x4 (both edges of
+     *      A and B) into a position that is never reset, only differences are
+     *          used. The velocity timer of QEI0 only times wheelISR().
+     *********************************************************************************
      */
-void PID(int RightValue, int FrontValue) {
-
-    // Calculate proportional terms
-    proportionalRight = (RightValue - TARGET_VALUE) / 20;
-
-    // Calculate integral terms
-    integralRight = (RightValue - TARGET_VALUE);
-
-    // Calculate derivative terms
-    derivativeRight = ((RightValue - TARGET_VALUE) - lastProportionalRight) * (3 / 2);
-
-    // Calculate PID result
-    pidRight = proportionalRight + (integralRight / 10000) + derivativeRight;
-
-    // Update some values for proper calculations of the next PID update
-    lastProportionalRight = (RightValue - TARGET_VALUE);
-
-    // Check if dead end & U-Turn
-    if ((pidRight < 25) && (FrontValue > 2000))
-    {
-        GPIOPinWrite(GPIO_PORTE_BASE, GPIO_PIN_1, 0); //left-motor-backward
-        GPIOPinWrite(GPIO_PORTB_BASE, GPIO_PIN_6, GPIO_PIN_6); //right-motor-forward
-
-
-        PWMPulseWidthSet(PWM1_BASE, PWM_OUT_2, 99 * PWM_LOAD / 100); //left motor
-        PWMPulseWidthSet(PWM1_BASE, PWM_OUT_3, 99 * PWM_LOAD / 100); //right motor
-    }
-    // Turn Left
-    else if ((pidRight > 27) && (FrontValue < 1000))
-    {
-        GPIOPinWrite(GPIO_PORTE_BASE, GPIO_PIN_1, GPIO_PIN_1); //forward
-        GPIOPinWrite(GPIO_PORTB_BASE, GPIO_PIN_6, GPIO_PIN_6); //forward
-
-        PWMPulseWidthSet(PWM1_BASE, PWM_OUT_2, 70 * PWM_LOAD / 100); //left slow
-        PWMPulseWidthSet(PWM1_BASE, PWM_OUT_3, 80 * PWM_LOAD / 100); //right
-    }
-    // Turn Right
-    else if ((pidRight > -80) && (pidRight < -20) && (FrontValue < 1000))
-    {
-        GPIOPinWrite(GPIO_PORTE_BASE, GPIO_PIN_1, GPIO_PIN_1); //forward
-        GPIOPinWrite(GPIO_PORTB_BASE, GPIO_PIN_6, GPIO_PIN_6); //forward
-
-        PWMPulseWidthSet(PWM1_BASE, PWM_OUT_2, 75 * PWM_LOAD / 100); //left
-        PWMPulseWidthSet(PWM1_BASE, PWM_OUT_3, 65 * PWM_LOAD / 100); //right slow
-    }
-    // Sharp Right (used when the robot encounters an intersection)
-    else if (pidRight < -100 && FrontValue < 1400)
-    {
-        GPIOPinWrite(GPIO_PORTE_BASE, GPIO_PIN_1, GPIO_PIN_1); //forward
-        GPIOPinWrite(GPIO_PORTB_BASE, GPIO_PIN_6, GPIO_PIN_6); //forward
-
-        PWMPulseWidthSet(PWM1_BASE, PWM_OUT_2, 99 * PWM_LOAD / 100); //left
-        PWMPulseWidthSet(PWM1_BASE, PWM_OUT_3, 17 * PWM_LOAD / 100); //right slow
-        SysCtlDelay(500); //make sure robot does not exit out of a turn too early
-    }
-    // Go straight
-    else if ((pidRight > -20) && (pidRight < 20) && (FrontValue < 1800))
-    {
-        GPIOPinWrite(GPIO_PORTE_BASE, GPIO_PIN_1, GPIO_PIN_1); //forward
-        GPIOPinWrite(GPIO_PORTB_BASE, GPIO_PIN_6, GPIO_PIN_6); //forward
+void ConfigureQEI(void) {
+    uint32_t period = SysCtlClockGet() / WHEEL_LOOP_HZ;
+
+    SysCtlPeripheralEnable(SYSCTL_PERIPH_QEI0);
+    SysCtlPeripheralEnable(SYSCTL_PERIPH_QEI1);
+    SysCtlPeripheralEnable(SYSCTL_PERIPH_GPIOD);
+    SysCtlPeripheralEnable(SYSCTL_PERIPH_GPIOC);
+
+    // PD7 is the NMI pin, unlock it before it can take another function
+    HWREG(GPIO_PORTD_BASE + GPIO_O_LOCK) = GPIO_LOCK_KEY;
+    HWREG(GPIO_PORTD_BASE + GPIO_O_CR) |= GPIO_PIN_7;
+    HWREG(GPIO_PORTD_BASE + GPIO_O_LOCK) = 0;
+
+    GPIOPinConfigure(GPIO_PD6_PHA0);
+    GPIOPinConfigure(GPIO_PD7_PHB0);
+    GPIOPinConfigure(GPIO_PC5_PHA1);
+    GPIOPinConfigure(GPIO_PC6_PHB1);
+    GPIOPinTypeQEI(GPIO_PORTD_BASE, GPIO_PIN_6 | GPIO_PIN_7);
+    GPIOPinTypeQEI(GPIO_PORTC_BASE, GPIO_PIN_5 | GPIO_PIN_6);
+
+    // The right motor is mounted mirrored, swapping A and B makes forward count up
+    QEIConfigure(QEI_LEFT_BASE, QEI_CONFIG_CAPTURE_A_B | QEI_CONFIG_NO_RESET |
+                 QEI_CONFIG_QUADRATURE | QEI_CONFIG_NO_SWAP, 0xFFFFFFFF);
+    QEIConfigure(QEI_RIGHT_BASE, QEI_CONFIG_CAPTURE_A_B | QEI_CONFIG_NO_RESET |
+                 QEI_CONFIG_QUADRATURE | QEI_CONFIG_SWAP, 0xFFFFFFFF);
+    QEIVelocityConfigure(QEI_LEFT_BASE, QEI_VELDIV_1, period);
+    QEIVelocityEnable(QEI_LEFT_BASE);
+    QEIEnable(QEI_LEFT_BASE);
+    QEIEnable(QEI_RIGHT_BASE);
+    // wheelISR() is enabled by startRun()
+}
 
-        PWMPulseWidthSet(PWM1_BASE, PWM_OUT_2, 70 * PWM_LOAD / 100);
-        PWMPulseWidthSet(PWM1_BASE, PWM_OUT_3, 70 * PWM_LOAD / 100);
-    }
-    // Special straight (used to prevent robot from hitting wall during sharp right turn)
-    else if ((pidRight > -50) && (pidRight < 0) && (FrontValue > 1000) && (FrontValue < 1500))
-    {
-        GPIOPinWrite(GPIO_PORTE_BASE, GPIO_PIN_1, GPIO_PIN_1); //forward
-        GPIOPinWrite(GPIO_PORTB_BASE, GPIO_PIN_6, GPIO_PIN_6); //forward
+    /*
+     *********************************************************************************
+     * Encoder position of one wheel (0 = left, 1 = right) [counts].
+     *********************************************************************************
+     */
+int32_t readQei(uint32_t wheel) {
+    return (int32_t)QEIPositionGet(wheel ? QEI_RIGHT_BASE : QEI_LEFT_BASE);
+}
 
-        PWMPulseWidthSet(PWM1_BASE, PWM_OUT_2, 80 * PWM_LOAD / 100);
-        PWMPulseWidthSet(PWM1_BASE, PWM_OUT_3, 80 * PWM_LOAD / 100);
+/*
+ *************************************************************************************
+ * HWI FUNCTION - WHEEL SPEED LOOP (USE_QEI)
+ *************************************************************************************
+ */
+    /*
+     *********************************************************************************
+     *  Runs at WHEEL_LOOP_HZ on the QEI0 velocity timer, between PID() ticks.
+     *      PID() picks wheel speeds (wheelTarget[]) instead of duties, this loop
+     *          holds them against battery sag, motor mismatch and the floor.
+     *      A brake from PID() goes straight to the driver and clears the loops.
+     *********************************************************************************
+     */
+void wheelISR(UArg arg) {
+    const float dt = 1.0f / WHEEL_LOOP_HZ;
+
+    QEIIntClear(QEI_LEFT_BASE, QEI_INTTIMER);
+
+    updateWheelSpeed(&wheelConfig, &wheels[0], readQei(0), dt);
+    updateWheelSpeed(&wheelConfig, &wheels[1], readQei(1), dt);
+    if (pidMode == MOTOR_BRAKE) {
+        wheelDuty(&wheelConfig, &wheels[0], 0.0f, dt);
+        wheelDuty(&wheelConfig, &wheels[1], 0.0f, dt);
+        brakeMotors();
+        return;
     }
+    driveMotors((int)roundf(wheelDuty(&wheelConfig, &wheels[0], wheelTarget[0], dt) * DUTY_ONE),
+                (int)roundf(wheelDuty(&wheelConfig, &wheels[1], wheelTarget[1], dt) * DUTY_ONE));
+}
 
     /*
-     * Calculates error and stores in buffer
-     *
-     * Only runs every 100[ms] by only running when error_count is even
-     *
-     * Manually fill both buffers once to prevent outputting empty buffers initially
-     *  fills first buffer when bufferCt is between 0 and 19
-     *  fills second buffer when bufferCt is between 20 and 39
-     *
+     *********************************************************************************
+     * Red, blue, green LEDs (GPIO_PIN_1, 2, 3), written only when they change.
+     *********************************************************************************
      */
-    if ((error_count % 2) == 0) {
-        // Reset LEDs
-        GPIOPinWrite(GPIO_PORTF_BASE, GPIO_PIN_1|GPIO_PIN_2|GPIO_PIN_3, 0);
-        // Constant blue LED to signal that it's collecting data
-        GPIOPinWrite(GPIO_PORTF_BASE, GPIO_PIN_2, GPIO_PIN_2);
-
-        // Error = measured distance - desired distance
-        error = RightValue - TARGET_VALUE;
-        // Makes sure error is positive (absolute value)
-        if (error < 0) {
-            error = error * (-1);
-        }
-        // Fills the first buffer manually once
-        if (bufferCt < 20) {
-            buffer[k] = error;
-            ++k;
-        }
-        // Fills the second buffer manually once
-        if ((bufferCt >= 20) && (bufferCt < 40)) {
-            buffer_2[m] = error;
-            ++m;
-        }
-        // Fill temporary buffer for the remainder of the program
-        if (i < BUFFER_SIZE) {
-            temp_buffer[i] = error;
-        }
-        ++i; //increment temp_buffer[] index
-        ++bufferCt; //used to fill first two buffers manually
-        error_count = 0; //restart error counter
-
+static inline void setLeds(uint32_t pins) {
+    if (pins != ledShadow) {
+        HWREG(GPIO_PORTF_BASE + GPIO_O_DATA + ((GPIO_PIN_1|GPIO_PIN_2|GPIO_PIN_3) << 2)) = pins;
+        ledShadow = pins;
     }
-    error_count += 1; //increment error counter
 }
 
 /*
  *************************************************************************************
- * TIMER FUNCTION - LIGHT SENSOR
+ * TASK FUNCTION - TELEMETRY
  *************************************************************************************
  */
     /*
      *********************************************************************************
-     *  Gets light sensor value from light sensor by timing how long it takes for
-     *      the light sensor's voltage reading to drop to zero
-     *
-     *  Use light sensor value to determine surface (white or black)
-     *
-     *  If it's a black surface, increment blkLineCounter to determine the width
-     *      Through testing, we were able to determine the range that blkLineCounter
-     *          could fall into for a thin and thick line
-     *
-     * If the robot cross the thin line for a first time, then read data
+     *  Lowest priority work: everything that talks to the PC or the LEDs.
      *
-     * If the robot cross the thin line for a second time, then stop reading data
-     *  and output partial buffer.
+     *  PID() and lightSensorCalculation() only post a TelemetryMsg to
+     *      Telemetry_Mbx and never wait. UART output happens here, so
+     *          a slow print can never delay a control tick.
      *
-     * If the robot cross the thick line, then stop program.
+     *  PID() posts a snapshot of every channel at SNAPSHOT_HZ. Each channel
+     *      keeps RATE_x of them per second and prints a line of DEPTH_x
+     *          samples when full, e.g. ERROR: BUFFER_SIZE values every 2 seconds.
      *
+     *  Blue LED = collecting data, green LED = transmitting to PC,
+     *      red LED = run completed.
      *********************************************************************************
      */
-void lightSensorCalculation(void) {
-    // Clear timer2A interrupt flag
-    TimerIntClear(TIMER2_BASE, TIMER_TIMA_TIMEOUT);
-
-    // Light sensor config
-    uint32_t lightSensorValue = 0;
-    uint32_t lightCounter = 0;
-    // Set light sensor pin to output
-    GPIOPinTypeGPIOOutput(GPIO_PORTF_BASE, GPIO_PIN_4);
-    // Output voltage to light sensor
-    GPIOPinWrite(GPIO_PORTF_BASE, GPIO_PIN_4, GPIO_PIN_4);
-    SysCtlDelay(100); //give time to charge
-    // Set to input to read changes in voltage
-    GPIOPinTypeGPIOInput(GPIO_PORTF_BASE, GPIO_PIN_4);
-    // Time how long it takes for voltage to drop to zero
-    while (GPIOPinRead(GPIO_PORTF_BASE, GPIO_PIN_4) != 0) {
-        lightCounter++;
-    }
-    lightSensorValue = lightCounter;
-
-    // Determine White or Black Surface
-    if (lightSensorValue > 2000) {
-        // Black Surface
-        ++blkLineCounter; //used to determine width of black line
-    }
-    else {
-        // White Surface
-        // If black surface is a thin line, read data
-        if ((blkLineCounter > 1) && (blkLineCounter < 10) && (readData == 1)) {
-            // Start Buffer_Clk function in RTOS
-            Clock_start(Buffer_Clk);
-            readData = 0; //indicate that data has been read
-            blkLineCounter = 0; //reset counter
+void telemetryTask(UArg arg0, UArg arg1) {
+    TelemetryMsg msg;
+    uint32_t start;
+    uint32_t n;
+
+    while (true) {
+        // Wake up now and then to answer console commands
+        if (!Mailbox_pend(Telemetry_Mbx, &msg, CONSOLE_POLL_TICKS)) {
+            pollConsole();
+            continue;
+        }
+        start = readCycles();
 
+        switch (msg.type) {
+        case TELEMETRY_START:
             // Set to output to display LEDs
             GPIOPinTypeGPIOOutput(GPIO_PORTF_BASE, GPIO_PIN_1|GPIO_PIN_2|GPIO_PIN_3);
+            // Constant blue LED to signal that it's collecting data
+            setLeds(GPIO_PIN_2);
+            snapshotCount = 0;
+            for (n = 0; n < CHANNELS; ++n) {
+                channelCount[n] = 0;
+#if TELEMETRY_COMPRESSED
+                codecBegin(&channelFrames[n], (uint8_t)n);
+#endif
+            }
             // Used to indicate where reading starts on PuTTY
             UARTprintf("\n\n*********READING DATA*********\n\n");
-        }
-        // If thin line has been crossed the 2nd time
-        else if ((blkLineCounter > 1) && (blkLineCounter < 10) && (readData == 0)) {
-            // Stops Buffer_Clk
-            Clock_stop(Buffer_Clk);
-
-            // Outputs Partially filled buffer
-            if (swap == 0) {
-                // Reset LEDs
-                GPIOPinWrite(GPIO_PORTF_BASE, GPIO_PIN_1|GPIO_PIN_2|GPIO_PIN_3, 0);
-                // Constant green LED to signal that it's transmitting to PC
-                GPIOPinWrite(GPIO_PORTF_BASE, GPIO_PIN_3, GPIO_PIN_3);
-                UARTprintf("Partial Buffer: ");
-                for (j = 0; j < BUFFER_SIZE; ++j) {
-                    UARTprintf("%X, ", buffer[j]);
-                    if(UARTBusy(UART1_BASE)) {
-                        buffer_2[j] = temp_buffer[j];
-                    }
-                }
-                UARTprintf("\r\n\n");
-            }
+            break;
 
-            else if (swap == 1) {
-                // Reset LEDs
-                GPIOPinWrite(GPIO_PORTF_BASE, GPIO_PIN_1|GPIO_PIN_2|GPIO_PIN_3, 0);
-                // Constant green LED to signal that it's transmitting to PC
-                GPIOPinWrite(GPIO_PORTF_BASE, GPIO_PIN_3, GPIO_PIN_3);
-                UARTprintf("Partial Buffer: ");
-                for (j = 0; j < BUFFER_SIZE; ++j) {
-                    UARTprintf("%X, ", buffer_2[j]);
-
-                    if(UARTBusy(UART1_BASE)) {
-                        buffer[j] = temp_buffer[j];
-                    }
-                }
-                UARTprintf("\r\n\n");
-            }
-            i = 0;
-            // Output of partial buffer is complete
+        case TELEMETRY_SNAPSHOT:
+            storeSnapshot(&msg);
+            break;
 
-            blkLineCounter = 0; //reset counter
+        case TELEMETRY_STOP:
+            // Outputs partially filled channels
+            for (n = 0; n < CHANNELS; ++n) {
+                flushChannel(n, "Partial ");
+            }
 
             // Reset LEDs
-            GPIOPinWrite(GPIO_PORTF_BASE, GPIO_PIN_1|GPIO_PIN_2|GPIO_PIN_3, 0);
+            setLeds(0);
             // Set to input to prevent LED from turning back on
             GPIOPinTypeGPIOInput(GPIO_PORTF_BASE, GPIO_PIN_1|GPIO_PIN_2|GPIO_PIN_3);
             // Used to indicate where reading stops on PuTTY
             UARTprintf("\n\n!!!!!!!!!!!!!STOPPED READING!!!!!!!!!!!!!\n\n");
-        }
-        // If black surface is a thick line, stop program
-        else if (blkLineCounter > 10) {
-            PWMOutputState(PWM1_BASE, PWM_OUT_2_BIT | PWM_OUT_3_BIT, false);
-            Clock_stop(PID_Clk);
-            Clock_stop(Buffer_Clk);
-
-            /*Reset Counter*/
-            blkLineCounter = 0;
+            break;
 
+        case TELEMETRY_FINISH:
             // Set to output to display LEDs
             GPIOPinTypeGPIOOutput(GPIO_PORTF_BASE, GPIO_PIN_1|GPIO_PIN_2|GPIO_PIN_3);
-            // Reset LEDs
-            GPIOPinWrite(GPIO_PORTF_BASE, GPIO_PIN_1|GPIO_PIN_2|GPIO_PIN_3, 0);
             // Turn on red LED to signal the robot has stopped
-            GPIOPinWrite(GPIO_PORTF_BASE, GPIO_PIN_1, GPIO_PIN_1);
+            setLeds(GPIO_PIN_1);
 
             // Used to indicate that program has stopped on PuTTY
             UARTprintf("\n\n===========RUN COMPLETED===========\n\n");
+            printStats("SEGMENT", &segmentStats);
+            printStats("RUN", &runStats);
+            printBranches();
+            finishMap();
+            runActive = 0;
+            printRateGroups();
+            printCpuMonitor();
+            break;
         }
-    }
 
-    lightCounter = 0; //reset light sensor value
+        recordTelemetryCycles(readCycles() - start);
+    }
 }
 
-/*
- *************************************************************************************
- * MAIN
+    /*
+     *********************************************************************************
+     * Keeps the samples of a snapshot that each channel's decimation asks for
+     *  and prints every channel that reached its depth.
+     *********************************************************************************
+     */
+void storeSnapshot(const TelemetryMsg *msg) {
+    uint32_t n;
+
+    for (n = 0; n < CHANNELS; ++n) {
+        if ((snapshotCount % telemetryChannels[n].every) != 0) {
+            continue;
+        }
+#if TELEMETRY_COMPRESSED
+        codecPut(&channelFrames[n], msg->values[n]);
+#else
+        channelValues[n][channelCount[n]] = msg->values[n];
+#endif
+        ++channelCount[n];
+        if (channelCount[n] == telemetryChannels[n].depth) {
+            flushChannel(n, "");
+        }
+    }
+    ++snapshotCount;
+}
+
+    /*
+     *********************************************************************************
+     * Prints one channel's collected samples and empties it.
+     *  Text mode prints "<label><NAME>: v, v, ...", compressed mode sends the
+     *      channel's frame instead. The status line follows every ERROR line.
+     *********************************************************************************
+     */
+void flushChannel(uint32_t channel, const char *label) {
+#if !TELEMETRY_COMPRESSED
+    uint32_t n;
+#endif
+
+    if (channelCount[channel] == 0) {
+        return;
+    }
+
+    // Constant green LED to signal that it's transmitting to PC
+    setLeds(GPIO_PIN_3);
+
+#if TELEMETRY_COMPRESSED
+    sendFrame(&channelFrames[channel]);
+    codecBegin(&channelFrames[channel], (uint8_t)channel);
+#else
+    // Transmitting channel to PC in specified format
+    UARTprintf("%s%s: ", label, telemetryChannels[channel].name);
+    for (n = 0; n < channelCount[channel]; ++n) {
+        UARTprintf(telemetryChannels[channel].format, channelValues[channel][n]);
+    }
+    UARTprintf("\r\n");
+
+    if (channel == CHANNEL_ERROR) {
+        // Load and deadline status with every error line, text mode only: the
+        //  frames are the whole stream when compressed, the end-of-run report and
+        //  "LD" print the same counts
+        UARTprintf("CPU %d%% (peak %d%%)", cpu.load, cpu.loadPeak);
+        for (n = 0; n < RATE_GROUPS; ++n) {
+            UARTprintf(", %s misses %d overruns %d", rateGroups[n].name,
+                       rateGroups[n].deadlineMisses, rateGroups[n].overruns);
+        }
+        UARTprintf("\r\n\n");
+    }
+#endif
+    // End of transmission
+    channelCount[channel] = 0;
+
+    // Back to blue LED, still collecting data
+    setLeds(GPIO_PIN_2);
+}
+
+    /*
+     *********************************************************************************
+     * Finishes a codec frame and writes it to UART1 as raw bytes.
+     *********************************************************************************
+     */
+void sendFrame(CodecFrame *frame) {
+    uint32_t length = codecEnd(frame);
+    uint32_t n;
+
+    for (n = 0; n < length; ++n) {
+        UARTCharPut(UART1_BASE, frame->bytes[n]);
+    }
+}
+
+    /*
+     *********************************************************************************
+     * Queues an event (START, STOP, FINISH) for telemetryTask().
+     *********************************************************************************
+     */
+void postTelemetry(uint32_t type) {
+    TelemetryMsg msg;
+
+    msg.type = type;
+    postMessage(&msg);
+}
+
+    /*
+     *********************************************************************************
+     * Queues a message for telemetryTask() without waiting.
+     *  Safe from Hwi, Swi and Task context. A full mailbox drops the message.
+     *********************************************************************************
+     */
+void postMessage(TelemetryMsg *msg) {
+    if (!Mailbox_post(Telemetry_Mbx, msg, BIOS_NO_WAIT)) {
+        ++telemetryDropped;
+    }
+}
+
+    /*
+     *********************************************************************************
+     * Keeps the worst time telemetryTask() spent on one message.
+     *********************************************************************************
+     */
+void recordTelemetryCycles(uint32_t cycles) {
+    if (cycles > telemetryCyclesWorst) {
+        telemetryCyclesWorst = cycles;
+    }
+}
+
+/*
+ *************************************************************************************
+ * CLOCK FUNCTION - BASE TICK
+ *************************************************************************************
+ */
+    /*
+     *********************************************************************************
+     * PID_Clk runs the rate groups every 50[ms].
+     *********************************************************************************
+     */
+void prepPID(void) {
+#if HIGH_RATE_MODE
+    // No PID_Clk in this mode, controlISR() runs the rate groups
+#else
+    runRateGroups();
+#endif
+}
+
+/*
+ *************************************************************************************
+ * HWI FUNCTION - ADC SS0 (HIGH_RATE_MODE / ADC_PWM_TRIGGER)
+ *************************************************************************************
+ */
+    /*
+     *********************************************************************************
+     * Timer1 triggers ADC0 SS0 every 1/CONTROL_RATE_HZ.
+     *
+     * Runs when SS0 has sampled both sensors, no processor trigger or busy wait.
+     *
+     * ADC values are stored for the sensing group, then the rate groups run
+     *
+     * ADC_PWM_TRIGGER: runs every PWM period instead. The FIFO is drained
+     *  (8 entries = 8 / ADC_STEPS whole periods, in case a long base tick held this
+     *      off, one more overflows and the window is dropped), every
+     *      ADC_AVERAGE_PERIODS periods the averages become the sensor values.
+     *  In HIGH_RATE_MODE that is also the base tick.
+     *********************************************************************************
+     */
+void controlISR(UArg arg) {
+#if ADC_PWM_TRIGGER
+    uint32_t samples[8];            //FIFO depth, whole periods of ADC_STEPS samples
+    int32_t count;
+    int32_t i;
+#if HIGH_RATE_MODE
+    int tick = 0;
+#endif
+
+    // Clear ADC0 SS0 interrupt flag
+    ADCIntClear(ADC0_BASE, SEQ0);
+
+    count = ADCSequenceDataGet(ADC0_BASE, SEQ0, samples);
+    if (ADCSequenceOverflow(ADC0_BASE, SEQ0)) {
+        // Lost samples, the pairs may be out of step: drop this window
+        ADCSequenceOverflowClear(ADC0_BASE, SEQ0);
+        adcSumRight = 0;
+        adcSumFront = 0;
+        adcSumLeft = 0;
+        adcPeriods = 0;
+        ++adcOverflows;
+        return;
+    }
+
+    // Step 0 = right sensor, step 1 = front sensor, step 2 = left sensor
+    for (i = 0; i + ADC_STEPS - 1 < count; i += ADC_STEPS) {
+        adcSumRight += samples[i];
+        adcSumFront += samples[i + 1];
+#if USE_LEFT_SENSOR
+        adcSumLeft += samples[i + 2];
+#endif
+        if (++adcPeriods == ADC_AVERAGE_PERIODS) {
+            rightSensorValue = (adcSumRight + ADC_AVERAGE_PERIODS / 2) / ADC_AVERAGE_PERIODS;
+            frontSensorValue = (adcSumFront + ADC_AVERAGE_PERIODS / 2) / ADC_AVERAGE_PERIODS;
+            leftSensorValue = (adcSumLeft + ADC_AVERAGE_PERIODS / 2) / ADC_AVERAGE_PERIODS;
+            adcSumRight = 0;
+            adcSumFront = 0;
+            adcSumLeft = 0;
+            adcPeriods = 0;
+#if HIGH_RATE_MODE
+            tick = 1;
+#endif
+        }
+    }
+#if HIGH_RATE_MODE
+    if (tick) {
+        runRateGroups();
+    }
+#endif
+#else
+    uint32_t samples[ADC_STEPS];
+
+    // Clear ADC0 SS0 interrupt flag
+    ADCIntClear(ADC0_BASE, SEQ0);
+
+    // Step 0 = right sensor, step 1 = front sensor, step 2 = left sensor
+    ADCSequenceDataGet(ADC0_BASE, SEQ0, samples);
+    rightSensorValue = samples[0];
+    frontSensorValue = samples[1];
+#if USE_LEFT_SENSOR
+    leftSensorValue = samples[2];
+#endif
+
+    runRateGroups();
+#endif
+}
+
+/*
+ *************************************************************************************
+ * RATE GROUPS
+ *************************************************************************************
+ */
+    /*
+     *********************************************************************************
+     *  Runs every group that is due on this base tick, fastest group first.
+     *
+     *  Each run is timed with the DWT cycle counter. A run longer than the
+     *      group's budget counts as an overrun. A run released more than
+     *          DEADLINE_SLACK late, or still running at its next release,
+     *              counts as a deadline miss. The whole tick is timed too,
+     *                  for the "does the loop fit" budget report.
+     *  The tick also closes the CPU load window, the idle function alone never
+     *      would at 100% load.
+     *********************************************************************************
+     */
+void runRateGroups(void) {
+    uint32_t tickStart = readCycles();
+    uint32_t start, end, cycles;
+    int n;
+
+    cpuLoadTick(&cpu, tickStart);
+
+    for (n = 0; n < RATE_GROUPS; ++n) {
+        RateGroup *group = &rateGroups[n];
+
+        if ((rateTick % group->divider) != 0) {
+            continue;
+        }
+        start = readCycles();
+        // Late release, e.g. PID_Clk held off by a higher priority Swi
+        if ((group->runs > 0) && releasedLate(start, group->lastStart, group->period)) {
+            ++group->deadlineMisses;
+        }
+        group->lastStart = start;
+
+        group->run();
+        end = readCycles();
+        cycles = cyclesSince(end, start);
+
+        if (ranPastRelease(start, end, group->period)) {
+            ++group->deadlineMisses;
+        }
+        if (cycles > group->cyclesWorst) {
+            group->cyclesWorst = cycles;
+        }
+        if (cycles > group->budget) {
+            ++group->overruns;
+        }
+        ++group->runs;
+    }
+    ++rateTick;
+
+    cycles = cyclesSince(readCycles(), tickStart);
+    if (cycles > tickCyclesWorst) {
+        tickCyclesWorst = cycles;
+    }
+    tickCyclesTotal += cycles;
+    ++tickCount;
+}
+
+    /*
+     *********************************************************************************
+     * Sets each group's period and budget in CPU cycles.
+     *  Called once from main before BIOS starts.
+     *********************************************************************************
+     */
+void initRateGroups(void) {
+    uint32_t tickCycles = SysCtlClockGet() / CONTROL_RATE_HZ;
+    int n;
+
+    for (n = 0; n < RATE_GROUPS; ++n) {
+        rateGroups[n].period = tickCycles * rateGroups[n].divider;
+        rateGroups[n].budget = rateGroups[n].period / 100 * rateGroups[n].budgetPercent;
+    }
+}
+
+    /*
+     *********************************************************************************
+     * SENSING GROUP - read the IR sensors (PID_Clk mode) and run the estimator.
+     *  With ADC_PWM_TRIGGER controlISR() has already stored the latest averages.
+     *********************************************************************************
+     */
+void senseGroup(void) {
+
+#if !HIGH_RATE_MODE && !ADC_PWM_TRIGGER
+#if USE_LEFT_SENSOR
+    uint32_t sides[2];
+
+    // Trigger the sample sequence 1, right then left sensor
+    ADCProcessorTrigger(ADC0_BASE, SEQ1);
+    ADCSequenceDataGet(ADC0_BASE, SEQ1, sides);
+    rightSensorValue = sides[0];
+    leftSensorValue = sides[1];
+#else
+    // Trigger the sample sequence 1
+    ADCProcessorTrigger(ADC0_BASE, SEQ1);
+
+    // Get results from sample sequence 1
+    ADCSequenceDataGet(ADC0_BASE, SEQ1, &rightSensorValue);
+#endif
+
+    // Trigger sample sequence 2
+    ADCProcessorTrigger(ADC0_BASE, SEQ2);
+
+    // Get results from sample sequence 2
+    ADCSequenceDataGet(ADC0_BASE, SEQ2, &frontSensorValue);
+#endif
+
+#if USE_ESTIMATOR
+    // Fuse both readings with the commanded wheel speeds
+    updateEstimator(rightSensorValue, frontSensorValue);
+#endif
+}
+
+    /*
+     *********************************************************************************
+     * CONTROL GROUP - pick a branch and drive the motors.
+     *********************************************************************************
+     */
+void controlGroup(void) {
+#if USE_ESTIMATOR
+    uint32_t right = estimatedRightValue;
+    uint32_t front = estimatedFrontValue;
+#else
+    uint32_t right = rightSensorValue;
+    uint32_t front = frontSensorValue;
+#endif
+
+#if USE_LEFT_SENSOR
+    // Both walls close: PID() steers for the middle of the corridor instead. The
+    //  left side has no estimate, so both sides are raw readings of the same sample
+    wallMode = corridorMode(wallMode, leftSensorValue, rightSensorValue);
+    if (wallMode == WALL_CENTER) {
+        right = centeredRightValue(leftSensorValue, rightSensorValue);
+        ++centeredTicks;
+    }
+#endif
+
+    // Calls PID function to perform PID using the estimated or given sensor values
+    PID(right, front);
+}
+
+    /*
+     *********************************************************************************
+     * BATTERY GROUP - pack voltage for the duty scaling (USE_BATTERY_COMP).
+     *  Reads the conversion the previous run started and starts the next one,
+     *      so it never waits on the ADC. The sensing group keeps SS1 / SS2.
+     *********************************************************************************
+     */
+void batteryGroup(void) {
+
+    if (ADCIntStatus(ADC0_BASE, SEQ3, false)) {
+        ADCSequenceDataGet(ADC0_BASE, SEQ3, &batteryCode);
+        ADCIntClear(ADC0_BASE, SEQ3);
+        updateBattery(&battery, batteryCodeToMv(batteryCode));
+    }
+    ADCProcessorTrigger(ADC0_BASE, SEQ3);
+}
+
+    /*
+     *********************************************************************************
+     * Stops the control loop in either mode.
+     *********************************************************************************
+     */
+void stopControl(void) {
+#if !HIGH_RATE_MODE
+    Clock_stop(PID_Clk);
+#endif
+#if USE_QEI
+    QEIIntDisable(QEI_LEFT_BASE, QEI_INTTIMER);
+#endif
+#if HIGH_RATE_MODE && ADC_PWM_TRIGGER
+    ADCIntDisable(ADC0_BASE, SEQ0);
+#elif HIGH_RATE_MODE
+    TimerDisable(TIMER1_BASE, TIMER_A);
+#endif
+}
+
+    /*
+     *********************************************************************************
+     *  Resets everything a run records and lets the motors go.
+     *      After a first run with a finished map the next run follows its plan.
+     *
+     *  main() calls this before BIOS_start(), the console "GO" after a run
+     *      restarts the control loop itself.
+     *********************************************************************************
+     */
+void startRun(void) {
+    readData = 1;
+    resetBarcode(&barcode);
+    resetLightCalibration(&lightCal);
+    memset(markerCounts, 0, sizeof(markerCounts));
+    speedZone = ZONE_NORMAL;
+    streaming = 0;
+    estimatorReady = 0;
+    resetStats(&segmentStats);
+    resetStats(&runStats);
+    memset(branchVisits, 0, sizeof(branchVisits));
+    memset(branchDwellLongest, 0, sizeof(branchDwellLongest));
+    memset(branchTransitions, 0, sizeof(branchTransitions));
+    branchDwell = 0;
+    branchLast = BRANCH_NONE;
+    speedState.percent = 100.0f;
+    speedState.lastError = 0;
+    actuatorWrites = 0;
+    actuatorSkips = 0;
+
+    mapShortcut = (mapPlanLength > 0);
+    mapPlanStep = 0;
+    mapPassTicks = 0;
+    if (mapShortcut) {
+        mapTicks = 0;
+    }
+    else {
+        resetMap();
+    }
+
+    stopTicks = 0;
+    pidMode = MOTOR_DRIVE;
+    stopLatch = 0;
+    wallMode = WALL_RIGHT;
+    centeredTicks = 0;
+
+    runActive = 1;
+#if USE_QEI
+    // The inner loop starts from the open loop duties as speed targets
+    resetWheel(&wheels[0], readQei(0));
+    resetWheel(&wheels[1], readQei(1));
+    wheelTarget[0] = commandLeft * MM_PER_SEC_PER_DUTY / DUTY_ONE;
+    wheelTarget[1] = commandRight * MM_PER_SEC_PER_DUTY / DUTY_ONE;
+    QEIIntClear(QEI_LEFT_BASE, QEI_INTTIMER);
+    QEIIntEnable(QEI_LEFT_BASE, QEI_INTTIMER);
+#else
+    driveMotors(commandLeft, commandRight);
+#endif
+#if HIGH_RATE_MODE && ADC_PWM_TRIGGER
+    // Sampling never stops, start a fresh window and let the base tick run
+    adcSumRight = 0;
+    adcSumFront = 0;
+    adcSumLeft = 0;
+    adcPeriods = 0;
+    ADCIntClear(ADC0_BASE, SEQ0);
+    ADCIntEnable(ADC0_BASE, SEQ0);
+#elif HIGH_RATE_MODE
+    // Start sampling, first controlISR() runs once interrupts are enabled
+    TimerEnable(TIMER1_BASE, TIMER_A);
+#endif
+}
+
+    /*
+     *********************************************************************************
+     * Prints how much of its budget each group used.
+     *  A base tick longer than its period would delay the next ADC sample.
+     *********************************************************************************
+     */
+void printRateGroups(void) {
+    uint32_t period = SysCtlClockGet() / CONTROL_RATE_HZ;
+    uint32_t average = 0;
+    int n;
+
+    if (tickCount > 0) {
+        average = tickCyclesTotal / tickCount;
+    }
+    UARTprintf("BASE TICK: %d Hz, %d cycles\n", CONTROL_RATE_HZ, period);
+    UARTprintf("  worst %d cycles (%d%%), average %d cycles (%d%%), %d ticks\n",
+               tickCyclesWorst, 100 * tickCyclesWorst / period,
+               average, 100 * average / period, tickCount);
+    if (tickCyclesWorst > period) {
+        UARTprintf("  !! LOOP DOES NOT FIT, lower CONTROL_RATE_HZ !!\n");
+    }
+
+    for (n = 0; n < RATE_GROUPS; ++n) {
+        RateGroup *group = &rateGroups[n];
+        UARTprintf("%s: every %d ticks, budget %d cycles, worst %d, overruns %d/%d,"
+                   " deadline misses %d\n",
+                   group->name, group->divider, group->budget,
+                   group->cyclesWorst, group->overruns, group->runs,
+                   group->deadlineMisses);
+    }
+    UARTprintf("TELEMETRY: worst %d cycles per message, dropped %d\n",
+               telemetryCyclesWorst, telemetryDropped);
+}
+
+/*
+ *************************************************************************************
+ * CPU MONITOR
+ *************************************************************************************
+ */
+    /*
+     *********************************************************************************
+     * Starts the DWT cycle counter and the first load window.
+     *  Called once from main before BIOS starts.
+     *********************************************************************************
+     */
+void initCpuMonitor(void) {
+    HWREG(DEMCR) |= DEMCR_TRCENA;
+    HWREG(DWT_CYCCNT) = 0;
+    HWREG(DWT_CTRL) |= 1;
+    resetCpuMonitor(&cpu, readCycles(), SysCtlClockGet());
+}
+
+    /*
+     *********************************************************************************
+     * CPU cycles since reset, wraps every ~107 seconds at 40[MHz].
+     *  Only differences are used (cyclesSince()), so the wrap does not matter.
+     *********************************************************************************
+     */
+uint32_t readCycles(void) {
+    return HWREG(DWT_CYCCNT);
+}
+
+    /*
+     *********************************************************************************
+     *  Idle function, BIOS calls it over and over when nothing else is ready.
+     *      Adds the gap since its last call to the idle cycles when it was short
+     *          (cpuIdle()), runRateGroups() turns them into the load.
+     *  No critical section: the base tick only reads the idle total, so it can
+     *      preempt the update anywhere.
+     *********************************************************************************
+     */
+void cpuLoadIdle(void) {
+    cpuIdle(&cpu, readCycles());
+}
+
+    /*
+     *********************************************************************************
+     *  Console while the robot runs, called from telemetryTask().
+     *
+     *  LD - print CPU load, rate group budgets and deadline misses
+     *  BR - print branch coverage and transitions
+     *  GO - next run once the robot is back at the start after the thick line,
+     *          follows the map of the first run
+     *********************************************************************************
+     */
+void pollConsole(void) {
+    int32_t c;
+
+    while ((c = UARTCharGetNonBlocking(UART1_BASE)) != -1) {
+        if ((c == '\r') || (c == '\n')) {
+            if (!strcmp(console, "LD")) {
+                printRateGroups();
+                printCpuMonitor();
+            }
+            else if (!strcmp(console, "BR")) {
+                printBranches();
+            }
+            else if (!strcmp(console, "GO") && !runActive) {
+                startRun();
+#if !HIGH_RATE_MODE
+                Clock_start(PID_Clk);
+#endif
+            }
+            strcpy(console, "  ");
+        }
+        else {
+            // Keep the last 2 characters typed
+            console[0] = console[1];
+            console[1] = (char)c;
+        }
+    }
+}
+
+void printCpuMonitor(void) {
+    UARTprintf("CPU LOAD: %d%% (peak %d%%)\n", cpu.load, cpu.loadPeak);
+    UARTprintf("ACTUATORS: %d register writes, %d ticks with nothing to write\n",
+               actuatorWrites, actuatorSkips);
+#if ADC_PWM_TRIGGER
+    UARTprintf("ADC: trigger at compare %d of %d, %d FIFO overflows\n",
+               sampleCompare, PWM_LOAD_REG, adcOverflows);
+#endif
+#if USE_LEFT_SENSOR
+    UARTprintf("CORRIDOR: %d PID() ticks centered between both walls, left sensor %d\n",
+               centeredTicks, leftSensorValue);
+#endif
+#if USE_BATTERY_COMP
+    UARTprintf("BATTERY: %d [mV] (tuned at %d), duties x %d/100%s\n", (int)battery.mv,
+               (int)BATTERY_REFERENCE_MV, (int)(battery.scale * 100 + 0.5f),
+               USE_QEI ? " (not applied, wheel loop)" : "");
+#endif
+    UARTprintf("LIGHT: black above %d, white %d, black %d (%s)\n", lightCal.threshold,
+               lightCal.white, lightCal.black, !USE_LIGHT_CAL ? "profile" :
+               lightCal.split ? "learned" : "white only");
+    UARTprintf("MARKERS: zone %d, codes 2-7 read %d %d %d %d %d %d times\n", speedZone,
+               markerCounts[2], markerCounts[3], markerCounts[4], markerCounts[5],
+               markerCounts[6], markerCounts[7]);
+#if USE_LINE_ARRAY
+    UARTprintf("LINE ARRAY: %d reads, line %s at %d/%d\n", lineReads,
+               lineFound ? "seen" : "not seen", linePos, LINE_POSITION_MAX);
+#endif
+#if USE_QEI
+    UARTprintf("WHEELS: %d / %d [mm] travelled, %d / %d [mm/s] now\n",
+               (int)wheels[0].distance, (int)wheels[1].distance,
+               (int)wheels[0].speed, (int)wheels[1].speed);
+#endif
+}
+
+/*
+ *************************************************************************************
+ * RUN STATISTICS
+ *************************************************************************************
+ */
+    /*
+     *********************************************************************************
+     *  Run quality without keeping any history: every PID() tick adds one
+     *      error sample and the branch it took, O(1) time and memory.
+     *
+     *  Mean and variance use Welford's update, which stays accurate over long
+     *      runs where a plain sum of squares would lose float precision.
+     *      RMS comes from the same two values: rms^2 = mean^2 + variance.
+     *********************************************************************************
+     */
+void resetStats(RunStats *stats) {
+    memset(stats, 0, sizeof(RunStats));
+    stats->min = INT32_MAX;
+    stats->max = INT32_MIN;
+    stats->lastBranch = BRANCH_NONE;
+}
+
+void updateStats(RunStats *stats, int32_t error, int taken) {
+    float delta = error - stats->mean;
+    int32_t bin;
+
+    ++stats->count;
+    stats->mean += delta / stats->count;
+    stats->m2 += delta * (error - stats->mean);
+    if (error < stats->min) {
+        stats->min = error;
+    }
+    if (error > stats->max) {
+        stats->max = error;
+    }
+
+    // Bin 0 starts at -STATS_BINS/2 * STATS_BIN_WIDTH, negative errors round down
+    if (error >= 0) {
+        bin = error / STATS_BIN_WIDTH + STATS_BINS / 2;
+    }
+    else {
+        bin = (error + 1) / STATS_BIN_WIDTH + STATS_BINS / 2 - 1;
+    }
+    if (bin < 0) {
+        bin = 0;
+    }
+    if (bin >= STATS_BINS) {
+        bin = STATS_BINS - 1;
+    }
+    ++stats->histogram[bin];
+
+    ++stats->branchTicks[taken];
+    if ((taken == BRANCH_UTURN) && (stats->lastBranch != BRANCH_UTURN)) {
+        ++stats->uturns;
+    }
+    stats->lastBranch = taken;
+}
+
+    /*
+     *********************************************************************************
+     * Compact report, UARTprintf() has no %f so everything is rounded to integers.
+     *  Times are [ms], error values are [ADC codes].
+     *********************************************************************************
+     */
+void printStats(const char *label, const RunStats *stats) {
+    float variance;
+    int n;
+
+    if (stats->count == 0) {
+        UARTprintf("%s: no samples\n", label);
+        return;
+    }
+    variance = stats->m2 / stats->count;
+    UARTprintf("%s: %d ms, error mean %d, sd %d, rms %d, min %d, max %d, U-turns %d\n",
+               label, stats->count * 1000 / STATS_TICK_HZ,
+               (int)stats->mean, (int)sqrtf(variance),
+               (int)sqrtf(stats->mean * stats->mean + variance),
+               stats->min, stats->max, stats->uturns);
+    UARTprintf("  histogram (%d wide from %d):", STATS_BIN_WIDTH,
+               -(STATS_BINS / 2) * STATS_BIN_WIDTH);
+    for (n = 0; n < STATS_BINS; ++n) {
+        UARTprintf(" %d", stats->histogram[n]);
+    }
+    UARTprintf("\n  branch ms:");
+    for (n = 0; n < BRANCHES; ++n) {
+        UARTprintf(" %s %d", branchNames[n], stats->branchTicks[n] * 1000 / STATS_TICK_HZ);
+    }
+    UARTprintf("\n");
+}
+
+/*
+ *************************************************************************************
+ * BRANCH COVERAGE
+ *************************************************************************************
+ */
+    /*
+     *********************************************************************************
+     *  Which of PID()'s branches fire and how they follow each other.
+     *
+     *  Hits (ticks per branch) come from runStats.branchTicks, this adds the
+     *      number of visits, the longest visit and a from/to matrix of every
+     *          change. PID() starts in BRANCH_NONE with no visit counted.
+     *
+     *  Two branches with many changes both ways and short visits are
+     *      chattering on a threshold, see tools/branch_report.c.
+     *********************************************************************************
+     */
+void recordBranch(int taken) {
+    if (taken != branchLast) {
+        if (branchDwell > branchDwellLongest[branchLast]) {
+            branchDwellLongest[branchLast] = branchDwell;
+        }
+        ++branchTransitions[branchLast][taken];
+        ++branchVisits[taken];
+        branchLast = taken;
+        branchDwell = 0;
+    }
+    ++branchDwell;
+}
+
+    /*
+     *********************************************************************************
+     * Dumps the counters, read back by tools/branch_report.c. Times are [ms].
+     *********************************************************************************
+     */
+void printBranches(void) {
+    uint32_t visits, longest;
+    int from, to;
+
+    UARTprintf("BRANCHES:\n");
+    for (from = 0; from < BRANCHES; ++from) {
+        visits = branchVisits[from];
+        longest = branchDwellLongest[from];
+        // The visit in progress counts as well
+        if ((from == branchLast) && (branchDwell > longest)) {
+            longest = branchDwell;
+        }
+        UARTprintf("  %s: hits %d, visits %d, mean dwell %d ms, longest %d ms\n",
+                   branchNames[from], runStats.branchTicks[from], visits,
+                   (visits > 0) ? runStats.branchTicks[from] * 1000 / STATS_TICK_HZ / visits : 0,
+                   longest * 1000 / STATS_TICK_HZ);
+    }
+    UARTprintf("TRANSITIONS (row = from, column = to):\n");
+    for (from = 0; from < BRANCHES; ++from) {
+        UARTprintf("  %s:", branchNames[from]);
+        for (to = 0; to < BRANCHES; ++to) {
+            UARTprintf(" %d", branchTransitions[from][to]);
+        }
+        UARTprintf("\n");
+    }
+}
+
+/*
+ *************************************************************************************
+ * MAZE MAP
+ *************************************************************************************
+ */
+    /*
+     *********************************************************************************
+     *  First run: the right-wall follower explores, every SHARP entry is a right
+     *      opening (junction) and every UTURN entry a dead end. The events and the
+     *          PID() ticks between them become a tree rooted at the start.
+     *
+     *  A junction cannot be recognized by sight, so time decides: after a U-turn
+     *      the robot drives the dead-end leg back. A SHARP within
+     *          MAP_RETURN_SLACK of that time is the same junction again (its
+     *              next exit), otherwise the robot went through it without one.
+     *
+     *  At the thick line a BFS from the start finds the path to the finish, which
+     *      skips every dead-end branch. Seen from the path, a junction is either
+     *          taken (exit 1, its right opening) or driven past (any later exit).
+     *
+     *  Next run ("GO" on the console): takeSharp() follows mapPlan[] at each
+     *      right opening instead of always turning into it.
+     *
+     *  Tree mazes only (the wall follower needs that anyway). A dead end more than
+     *      one junction deep looks like a new junction on the way back and
+     *          stays on the path.
+     *********************************************************************************
+     */
+void resetMap(void) {
+    mapCount = 0;
+    mapCurrent = 0;
+    mapTicks = 0;
+    mapEventTick = 0;
+    mapReturning = 0;
+    mapNodes[0].exitsTaken = 1;
+    addMapNode(NODE_START, 0);
+}
+
+void addMapNode(uint8_t type, uint32_t edgeTicks) {
+    MapNode *node;
+
+    if (mapCount == MAP_NODES) {
+        return; //map full, the rest of the run is not recorded
+    }
+    node = &mapNodes[mapCount];
+    node->type = type;
+    node->parent = (uint8_t)mapCurrent;
+    node->exit = mapNodes[mapCurrent].exitsTaken;
+    node->exitsTaken = 1;
+    node->edgeTicks = edgeTicks;
+    ++mapCount;
+}
+
+// The robot is back at mapCurrent after a dead end and leaves on its next exit
+void mapBackAtJunction(uint32_t tick) {
+    ++mapNodes[mapCurrent].exitsTaken;
+    mapEventTick = tick;
+    mapReturning = 0;
+}
+
+    /*
+     *********************************************************************************
+     * Called by PID() every tick with the branch it took, before recordBranch().
+     *********************************************************************************
+     */
+void updateMap(int taken) {
+    uint32_t leg;
+
+    ++mapTicks;
+    if (mapPassTicks > 0) {
+        --mapPassTicks;
+    }
+    if (mapShortcut || (taken == branchLast)) {
+        return;
+    }
+
+    // Went through the junction without a SHARP on the way back
+    if (mapReturning && ((mapTicks > mapReturnDeadline) || (taken == BRANCH_UTURN))) {
+        mapBackAtJunction(mapReturnTick);
+    }
+
+    if (taken == BRANCH_SHARP) {
+        if (mapReturning) {
+            mapBackAtJunction(mapTicks);
+        }
+        else if (mapCount < MAP_NODES) {
+            addMapNode(NODE_JUNCTION, mapTicks - mapEventTick);
+            mapCurrent = mapCount - 1;
+            mapEventTick = mapTicks;
+        }
+    }
+    else if (taken == BRANCH_UTURN) {
+        leg = mapTicks - mapEventTick;
+        addMapNode(NODE_DEAD_END, leg);
+        mapReturning = 1;
+        mapReturnTick = mapTicks + leg;
+        mapReturnDeadline = mapTicks + leg * MAP_RETURN_SLACK / 100;
+    }
+}
+
+    /*
+     *********************************************************************************
+     * Called by PID() while a right opening is seen, returns 0 to drive past it.
+     *  Always 1 when mapping, the first run turns into every opening.
+     *********************************************************************************
+     */
+int takeSharp(void) {
+    if (!mapShortcut) {
+        return 1;
+    }
+    if (mapPassTicks > 0) {
+        // Still beside the opening that is being passed
+        mapPassTicks = MAP_PASS_TICKS;
+        return 0;
+    }
+    if (branchLast == BRANCH_SHARP) {
+        return 1; //already turning
+    }
+    // New opening, next junction on the path
+    if ((mapPlanStep < mapPlanLength) && !mapPlan[mapPlanStep++]) {
+        mapPassTicks = MAP_PASS_TICKS;
+        return 0;
+    }
+    return 1;
+}
+
+    /*
+     *********************************************************************************
+     * Thick line, called by telemetryTask() once the control loop is stopped.
+     *********************************************************************************
+     */
+void finishMap(void) {
+    if (mapShortcut) {
+        UARTprintf("SHORTCUT RUN: %d ms, first run %d ms, %d of %d junctions planned\n",
+                   mapTicks * 1000 / STATS_TICK_HZ, mapFirstRunTicks * 1000 / STATS_TICK_HZ,
+                   mapPlanStep, mapPlanLength);
+        return;
+    }
+    if (mapReturning) {
+        mapBackAtJunction(mapReturnTick);
+    }
+    addMapNode(NODE_FINISH, mapTicks - mapEventTick);
+    mapFirstRunTicks = mapTicks;
+    solveMap(mapCount - 1);
+    printMap();
+}
+
+    /*
+     *********************************************************************************
+     *  BFS over the tree (parent links both ways) from the start to the finish.
+     *      Each junction on the path gets one plan entry: take its right
+     *          opening if the path leaves through exit 1, drive past otherwise.
+     *********************************************************************************
+     */
+void solveMap(uint32_t finish) {
+    uint8_t queue[MAP_NODES];
+    uint8_t previous[MAP_NODES];
+    uint8_t seen[MAP_NODES];
+    uint8_t path[MAP_NODES];
+    uint32_t head = 0, tail = 0, length = 0;
+    uint32_t node, n;
+
+    mapPlanLength = 0;
+    if (mapNodes[finish].type != NODE_FINISH) {
+        return; //map filled up before the finish
+    }
+    memset(seen, 0, sizeof(seen));
+    queue[tail++] = 0;
+    seen[0] = 1;
+    while ((head < tail) && !seen[finish]) {
+        node = queue[head++];
+        // Neighbours: the children of node and its parent
+        for (n = 1; n < mapCount; ++n) {
+            if (!seen[n] && (mapNodes[n].parent == node)) {
+                seen[n] = 1;
+                previous[n] = (uint8_t)node;
+                queue[tail++] = (uint8_t)n;
+            }
+        }
+        n = mapNodes[node].parent;
+        if (!seen[n]) {
+            seen[n] = 1;
+            previous[n] = (uint8_t)node;
+            queue[tail++] = (uint8_t)n;
+        }
+    }
+
+    // Walk back from the finish, path[] ends up finish first
+    for (node = finish; node != 0; node = previous[node]) {
+        path[length++] = (uint8_t)node;
+    }
+    // path[n] is a junction, path[n - 1] the node it leads to
+    for (n = length - 1; n > 0; --n) {
+        mapPlan[mapPlanLength++] = (mapNodes[path[n - 1]].exit == 1);
+    }
+}
+
+void printMap(void) {
+    uint32_t pathTicks = 0;
+    uint32_t n;
+
+    for (n = mapCount - 1; n != 0; n = mapNodes[n].parent) {
+        pathTicks += mapNodes[n].edgeTicks;
+    }
+    UARTprintf("MAP: %d nodes%s, first run %d ms, path %d ms\n", mapCount,
+               (mapCount == MAP_NODES) ? " (FULL)" : "",
+               mapFirstRunTicks * 1000 / STATS_TICK_HZ, pathTicks * 1000 / STATS_TICK_HZ);
+    for (n = 1; n < mapCount; ++n) {
+        UARTprintf("  %d: %s from %d exit %d, %d ms\n", n, nodeNames[mapNodes[n].type],
+                   mapNodes[n].parent, mapNodes[n].exit,
+                   mapNodes[n].edgeTicks * 1000 / STATS_TICK_HZ);
+    }
+    UARTprintf("PLAN:");
+    for (n = 0; n < mapPlanLength; ++n) {
+        UARTprintf(mapPlan[n] ? " TAKE" : " PASS");
+    }
+    UARTprintf("\n");
+}
+
+/*
+ *************************************************************************************
+ * WALL-DISTANCE ESTIMATOR
+ *************************************************************************************
+ */
+    /*
+     *********************************************************************************
+     * Converts an estimated distance [mm] back to an ADC code.
+     *  ADC code -> [mm] is a single lookup in adcToMM[] (adc_distance_table.h).
+     *********************************************************************************
+     */
+uint32_t distanceToADC(float distance) {
+    if (distance <= 0) {
+        return mmToADC[0];
+    }
+    if (distance >= ADC_TABLE_MAX_MM) {
+        return mmToADC[ADC_TABLE_MAX_MM];
+    }
+    return mmToADC[(uint32_t)(distance + 0.5f)];
+}
+
+    /*
+     *********************************************************************************
+     * Initializes the filter on the first measurements of the run.
+     *********************************************************************************
+     */
+void resetEstimator(float rDistance, float fDistance) {
+    wallOffset = rDistance;
+    wallHeading = 0;
+    frontDistance = fDistance;
+
+    offsetCov[0][0] = R_RIGHT;
+    offsetCov[0][1] = 0;
+    offsetCov[1][0] = 0;
+    offsetCov[1][1] = HEADING_LIMIT * HEADING_LIMIT;
+    frontCov = R_FRONT;
+
+    rightOutliers = 0;
+    frontOutliers = 0;
+    estimatorReady = 1;
+}
+
+    /*
+     *********************************************************************************
+     *  Small Kalman filter run by the sensing group, ahead of PID().
+     *
+     *  States: lateral offset to the right wall, heading relative to the wall
+     *      (positive = pointing at the wall) and distance to the wall ahead.
+     *
+     *  Predict: the commanded duties give the forward speed and the turn rate
+     *      offset -= speed * heading * dt
+     *      heading += turn rate * dt
+     *      front -= speed * dt
+     *
+     *  Update: right sensor measures the offset, front sensor the front distance.
+     *      The heading is never measured, it is observed through the offset.
+     *
+     *  A reading outside GATE_SIGMA standard deviations is ignored as noise.
+     *      GATE_RESET_COUNT outliers in a row means the wall really changed
+     *          (intersection, dead end) so the filter snaps to the new reading.
+     *********************************************************************************
+     */
+void updateEstimator(uint32_t rValue, uint32_t fValue) {
+    float rDistance = adcToMM[rValue & 0xFFF];
+    float fDistance = adcToMM[fValue & 0xFFF];
+    float speed, turnRate, a;
+    float p00, p01, p11;
+    float innovation, variance, gain0, gain1;
+
+    if (!estimatorReady) {
+        resetEstimator(rDistance, fDistance);
+    }
+
+#if USE_QEI
+    // Measured wheel speeds
+    speed = (wheels[0].speed + wheels[1].speed) / 2;
+    turnRate = (wheels[0].speed - wheels[1].speed) / WHEEL_BASE_MM;
+#else
+    // Commanded wheel speeds, none while the driver brakes (reverse stop or finish)
+    speed = MM_PER_SEC_PER_DUTY / DUTY_ONE * (commandLeft + commandRight) / 2;
+    turnRate = MM_PER_SEC_PER_DUTY / DUTY_ONE * (commandLeft - commandRight) / WHEEL_BASE_MM;
+    if (motorMode == MOTOR_BRAKE) {
+        speed = 0;
+        turnRate = 0;
+    }
+#endif
+
+    // Predict offset and heading, P = F*P*F' + Q with F = [1 a; 0 1]
+    a = -speed * SENSE_PERIOD;
+    wallOffset += a * wallHeading;
+    wallHeading += turnRate * SENSE_PERIOD;
+    p00 = offsetCov[0][0] + 2 * a * offsetCov[0][1] + a * a * offsetCov[1][1]
+            + Q_OFFSET * SENSE_PERIOD;
+    p01 = offsetCov[0][1] + a * offsetCov[1][1];
+    p11 = offsetCov[1][1] + Q_HEADING * SENSE_PERIOD;
+
+    // Predict front distance
+    frontDistance -= speed * SENSE_PERIOD;
+    frontCov += Q_FRONT * SENSE_PERIOD;
+
+    // Update offset and heading with the right sensor
+    innovation = rDistance - wallOffset;
+    variance = p00 + R_RIGHT;
+    if (innovation * innovation > GATE_SIGMA * GATE_SIGMA * variance) {
+        // Outlier: keep the prediction
+        ++rightOutliers;
+    }
+    else {
+        gain0 = p00 / variance;
+        gain1 = p01 / variance;
+        wallOffset += gain0 * innovation;
+        wallHeading += gain1 * innovation;
+        p11 -= gain1 * p01;
+        p01 -= gain0 * p01;
+        p00 -= gain0 * p00;
+        rightOutliers = 0;
+    }
+    offsetCov[0][0] = p00;
+    offsetCov[0][1] = p01;
+    offsetCov[1][0] = p01;
+    offsetCov[1][1] = p11;
+
+    // Update front distance with the front sensor
+    innovation = fDistance - frontDistance;
+    variance = frontCov + R_FRONT;
+    if (innovation * innovation > GATE_SIGMA * GATE_SIGMA * variance) {
+        ++frontOutliers;
+    }
+    else {
+        gain0 = frontCov / variance;
+        frontDistance += gain0 * innovation;
+        frontCov -= gain0 * frontCov;
+        frontOutliers = 0;
+    }
+
+    // Right wall really appeared or disappeared (intersection)
+    if (rightOutliers >= GATE_RESET_COUNT) {
+        wallOffset = rDistance;
+        wallHeading = 0;
+        offsetCov[0][0] = R_RIGHT;
+        offsetCov[0][1] = 0;
+        offsetCov[1][0] = 0;
+        offsetCov[1][1] = HEADING_LIMIT * HEADING_LIMIT;
+        rightOutliers = 0;
+    }
+    // Front wall really appeared or disappeared (corner, dead end)
+    if (frontOutliers >= GATE_RESET_COUNT) {
+        frontDistance = fDistance;
+        frontCov = R_FRONT;
+        frontOutliers = 0;
+    }
+
+    // Keep the heading physical
+    if (wallHeading > HEADING_LIMIT) {
+        wallHeading = HEADING_LIMIT;
+    }
+    else if (wallHeading < -HEADING_LIMIT) {
+        wallHeading = -HEADING_LIMIT;
+    }
+
+    // Convert back to ADC codes so PID() thresholds stay the same
+    estimatedRightValue = distanceToADC(wallOffset);
+    estimatedFrontValue = distanceToADC(frontDistance);
+}
+
+/*
+ *************************************************************************************
+ * PID
+ *************************************************************************************
+ */
+    /*
+     *  This function essentially follows a PID controller.
+     *      Gain values for the proportional, integral and
+     *          derivative terms are selected to tune the robot to follow the wall.
+     *
+     *  The proportional gain = PID_KP (1/20)
+     *  The integral gain = 1/10000
+     *  The differential gain = PID_KD (3/2, which was 1 in integer math)
+     *      per 50[ms] tick, wallPid() rescales it at other rates (PID_TUNED_HZ)
+     *
+     *  The math, the branch choice and the branch duties live in wall_control.h
+     *      so tools/maze_sim.c drives exactly like this.
+     *
+     *  Speed planner: cruise duties (left, right, straight, special) are scaled
+     *      by speedPercent, up on clear straights and down close to a wall.
+     *          kp and kd move toward PID_KP_FAST and PID_KD_FAST as it speeds up.
+     *
+     *  The target value chosen is TARGET_ADC (ADC code 2000, ~79[mm] in the FINAL
+     *      profile). Every threshold and duty comes from robot_profile.h.
+     *
+     *  Front thresholds are raw ADC codes, the ones the robot raced with.
+     *
+     *  The (current ADC values - target value) is defined as the error values
+     *      which will be stored in a buffer.
+     *
+     *  The ranges determine how close it is to the wall
+     *      and what actions must be taken to prevent the robot from crashing into the wall.
+     *
+     *  The error values are stored in the buffer which is used in the OutputBuffer()
+     */
+void PID(int RightValue, int FrontValue) {
+    int error = RightValue - TARGET_VALUE;
+    int left = commandLeft;
+    int right = commandRight;
+    float kp, kd;
+    uint32_t mode;
+
+    // Cruise speed from the room ahead, gains follow the speed
+    speedPercent = planSpeed(&speedConfigs[speedZone], &speedState,
+                             adcToMM[FrontValue & 0xFFF], error, branch, 1.0f / STATS_TICK_HZ);
+    scheduleGains(&speedConfigs[speedZone], speedPercent, &kp, &kd);
+
+    // Calculate PID result
+    pidRight = wallPid(error, lastErrorRight, kp, kd, 1.0f / STATS_TICK_HZ);
+
+    // Update some values for proper calculations of the next PID update
+    lastErrorRight = error;
+
+    // Outputs are held when no branch matches
+    branch = selectBranch(pidRight, FrontValue);
+    if ((branch == BRANCH_SHARP) && !takeSharp()) {
+        // Shortcut run: this opening leads to a dead end, drive past it
+        branch = BRANCH_STRAIGHT;
+    }
+    branchDuties(branch, speedPercent, &left, &right);
+
+    // Hard stop before a wheel reverses, the duties it was for follow it even
+    //  when no branch matches by then
+    mode = stopBeforeReverse(left, right, commandLeft, commandRight, REVERSE_BRAKE_TICKS,
+                             &stopTicks);
+    if ((branch != BRANCH_NONE) || (mode != pidMode)) {
+#if USE_QEI
+        // wheelISR() drives the motors, the duties are speed targets for it
+        wheelTarget[0] = left * MM_PER_SEC_PER_DUTY / DUTY_ONE;
+        wheelTarget[1] = right * MM_PER_SEC_PER_DUTY / DUTY_ONE;
+#else
+        // Only the pins and compares that changed
+        if (mode == MOTOR_BRAKE) {
+            brakeMotors();
+        }
+        else {
+            driveMotors(left, right);
+        }
+#endif
+        pidMode = mode;
+        commandLeft = left;
+        commandRight = right;
+    }
+    // Not in HIGH_RATE_MODE, PID() runs in controlISR() there and a busy wait
+    //  would hold off every other interrupt. The duties are already out either way.
+#if !HIGH_RATE_MODE
+    if (branch == BRANCH_SHARP) {
+        SysCtlDelay(500); //make sure robot does not exit out of a turn too early
+    }
+#endif
+
+    /*
+     * Run statistics, the segment restarts on the first tick after a START
+     */
+    if (streaming != segmentOpen) {
+        if (streaming) {
+            resetStats(&segmentStats);
+        }
+        segmentOpen = streaming;
+    }
+    updateStats(&runStats, RightValue - TARGET_VALUE, branch);
+    updateMap(branch);
+    recordBranch(branch);
+    if (segmentOpen) {
+        updateStats(&segmentStats, RightValue - TARGET_VALUE, branch);
+    }
+
+    /*
+     * Posts a snapshot of every telemetry channel to telemetryTask()
+     *
+     * Only runs every 50[ms] by only running every SNAPSHOT_DIVIDER control ticks,
+     *  the task thins each channel down to its own rate
+     *
+     * Only posts between the thin lines, the task does the buffering and printing
+     *
+     */
+    if ((error_count % SNAPSHOT_DIVIDER) == 0) {
+        if (streaming) {
+            TelemetryMsg msg;
+
+            // Error = measured distance - desired distance
+            error = RightValue - TARGET_VALUE;
+            // Makes sure error is positive (absolute value)
+            if (error < 0) {
+                error = error * (-1);
+            }
+            msg.type = TELEMETRY_SNAPSHOT;
+            msg.values[CHANNEL_ERROR] = error;
+            msg.values[CHANNEL_RIGHT] = RightValue;     //what PID() saw (estimate if USE_ESTIMATOR)
+            msg.values[CHANNEL_FRONT] = FrontValue;
+            msg.values[CHANNEL_PID] = (int32_t)pidRight;
+            msg.values[CHANNEL_BRANCH] = branch;
+            msg.values[CHANNEL_DUTY_LEFT] = abs(commandLeft) / DUTY_ONE; //[%]
+            msg.values[CHANNEL_DUTY_RIGHT] = abs(commandRight) / DUTY_ONE;
+            msg.values[CHANNEL_DIRECTION] = ((commandLeft >= 0) ? DIRECTION_LEFT : 0) |
+                                            ((commandRight >= 0) ? DIRECTION_RIGHT : 0);
+            msg.values[CHANNEL_LIGHT] = (int32_t)lightValue;
+            postMessage(&msg);
+        }
+        error_count = 0; //restart error counter
+    }
+    error_count += 1; //increment error counter
+}
+
+/*
+ *************************************************************************************
+ * REFLECTANCE ARRAY (USE_LINE_ARRAY)
+ *************************************************************************************
+ */
+    /*
+     *********************************************************************************
+     *  Charges every element together, then times all of them in one pass:
+     *      each loop reads the whole port once, so the counts are in the same
+     *          units as the PF4 sensor's loop and LIGHT_BLACK still applies.
+     *  recordDecays() only runs on the reads where an element fell.
+     *  Stops at LINE_ARRAY_TIMEOUT, the elements left are black anyway.
+     *********************************************************************************
+     */
+void readLineArray(uint32_t decays[]) {
+    uint32_t pending = LINE_ARRAY_MASK;
+    uint32_t levels;
+    uint32_t count;
+
+    // Output voltage to every element
+    GPIOPinTypeGPIOOutput(LINE_ARRAY_BASE, LINE_ARRAY_PINS);
+    GPIOPinWrite(LINE_ARRAY_BASE, LINE_ARRAY_PINS, LINE_ARRAY_PINS);
+    SysCtlDelay(100); //give time to charge
+    // Set to input to read changes in voltage
+    GPIOPinTypeGPIOInput(LINE_ARRAY_BASE, LINE_ARRAY_PINS);
+    // Time how long it takes each element's voltage to drop to zero
+    for (count = 0; (pending != 0) && (count < LINE_ARRAY_TIMEOUT); ++count) {
+        levels = (uint32_t)GPIOPinRead(LINE_ARRAY_BASE, LINE_ARRAY_PINS) >> LINE_ARRAY_FIRST_PIN;
+        if ((levels & pending) != pending) {
+            pending = recordDecays(decays, pending, levels, count);
+        }
+    }
+    recordDecays(decays, pending, 0, LINE_ARRAY_TIMEOUT);
+    ++lineReads;
+}
+
+/*
+ *************************************************************************************
+ * COURSE MARKERS
+ *************************************************************************************
+ */
+    /*
+     *********************************************************************************
+     *  Thin line or MARKER_TELEMETRY: the first one starts reading data, every
+     *      later one stops it and outputs the partial buffer.
+     *********************************************************************************
+     */
+void toggleReading(void) {
+    if (readData == 1) {
+        readData = 0; //indicate that data has been read
+
+        // PID() starts posting snapshots
+        streaming = 1;
+        postTelemetry(TELEMETRY_START);
+    }
+    else {
+        // telemetryTask() outputs the partially filled channels
+        streaming = 0;
+        postTelemetry(TELEMETRY_STOP);
+    }
+}
+
+    /*
+     *********************************************************************************
+     *  Carries out a multi-bar marker, what each code means is BARCODE_ACTIONS
+     *      in robot_profile.h, so markers are placed without touching this.
+     *  A zone holds until the next zone marker (or the next run).
+     *********************************************************************************
+     */
+void runMarker(uint32_t code) {
+    ++markerCounts[code];
+    switch (markerAction(code)) {
+    case MARKER_NORMAL:
+        speedZone = ZONE_NORMAL;
+        break;
+    case MARKER_FAST:
+        speedZone = ZONE_FAST;
+        break;
+    case MARKER_SLOW:
+        speedZone = ZONE_SLOW;
+        break;
+    case MARKER_TELEMETRY:
+        toggleReading();
+        break;
+    }
+}
+
+/*
+ *************************************************************************************
+ * TIMER FUNCTION - LIGHT SENSOR
+ *************************************************************************************
+ */
+    /*
+     *********************************************************************************
+     *  Gets light sensor value from light sensor by timing how long it takes for
+     *      the light sensor's voltage reading to drop to zero
+     *
+     *  Use light sensor value to determine surface (white or black)
+     *
+     *  If it's a black surface, decodeBarcode() counts it to determine the width
+     *      Through testing, we were able to determine the range that the width
+     *          could fall into for a thin and thick line
+     *      Several bars close together are a marker code (runMarker())
+     *
+     * If the robot cross the thin line for a first time, then read data
+     *
+     * If the robot cross the thin line for a second time, then stop reading data
+     *  and output partial buffer.
+     *
+     * If the robot cross the thick line, then stop program.
+     *
+     * Printing and LEDs are left to telemetryTask(), this only posts the event.
+     *
+     * USE_LINE_ARRAY: the darkest element stands in for the single sensor, so a
+     *  marker still reads with the robot off the center line, and linePos
+     *  tracks the line under the array.
+     *
+     *********************************************************************************
+     */
+void lightSensorCalculation(void) {
+    // Clear timer2A interrupt flag
+    TimerIntClear(TIMER2_BASE, TIMER_TIMA_TIMEOUT);
+
+    // Light sensor config
+    uint32_t lightSensorValue = 0;
+#if USE_LINE_ARRAY
+    readLineArray(lineDecays);
+#if USE_LIGHT_CAL
+    uint32_t element;
+
+    // Every element shares the threshold, so all of them train it
+    for (element = 0; element < LINE_ARRAY_SIZE; ++element) {
+        updateLightCalibration(&lightCal, lineDecays[element]);
+    }
+#endif
+    lightSensorValue = darkestDecay(lineDecays);
+    lineFound = linePosition(lineDecays, lightCal.white, lightCal.black, &linePos);
+#else
+    uint32_t lightCounter = 0;
+    // Set light sensor pin to output
+    GPIOPinTypeGPIOOutput(GPIO_PORTF_BASE, GPIO_PIN_4);
+    // Output voltage to light sensor
+    GPIOPinWrite(GPIO_PORTF_BASE, GPIO_PIN_4, GPIO_PIN_4);
+    SysCtlDelay(100); //give time to charge
+    // Set to input to read changes in voltage
+    GPIOPinTypeGPIOInput(GPIO_PORTF_BASE, GPIO_PIN_4);
+    // Time how long it takes for voltage to drop to zero
+    while (GPIOPinRead(GPIO_PORTF_BASE, GPIO_PIN_4) != 0) {
+        lightCounter++;
+    }
+    lightSensorValue = lightCounter;
+#if USE_LIGHT_CAL
+    updateLightCalibration(&lightCal, lightSensorValue);
+#endif
+#endif
+    lightValue = lightSensorValue;
+
+    // Determine White or Black Surface, barcode holds the widths of the bars
+    switch (decodeBarcode(&barcode, lightSensorValue, lightCal.threshold)) {
+    case LINE_THIN:
+        // If black surface is a thin line, read data or stop reading
+        toggleReading();
+        break;
+    case LINE_CODE:
+        // Multi-bar marker: speed zone or telemetry trigger
+        runMarker(barcode.code);
+        break;
+    case LINE_THICK:
+        // If black surface is a thick line, stop program
+        // Stop motors right here, only the report goes through telemetryTask()
+        // Latch first, so a PID() or wheelISR() tick this preempted cannot
+        //  drive them again, then no new ticks
+        stopLatch = 1;
+        stopControl();
+        brakeMotors();
+        streaming = 0;
+
+        postTelemetry(TELEMETRY_FINISH);
+        break;
+    }
+
+#if !USE_LINE_ARRAY
+    lightCounter = 0; //reset light sensor value
+#endif
+}
+
+/*
+ *************************************************************************************
+ * MAIN
  *************************************************************************************
  */
  int main(void) {
@@ -726,15 +2890,19 @@ void lightSensorCalculation(void) {
     ConfigurePeripherals();
 
     // Turn off motor to prevent robot resuming from last run
-    PWMOutputState(PWM1_BASE, PWM_OUT_2_BIT | PWM_OUT_3_BIT, false);
+    brakeMotors();
     // Reset LEDs
-    GPIOPinWrite(GPIO_PORTF_BASE, GPIO_PIN_1|GPIO_PIN_2|GPIO_PIN_3, 0);
+    setLeds(0);
+
+    // Cycle budgets for the sensing and control groups
+    initCpuMonitor();
+    initRateGroups();
 
     // Menu on terminal
     while(true) {
 
         UARTprintf("\n");
-        UARTprintf("Version: FINAL\n");
+        UARTprintf("Version: FINAL (profile %s)\n", PROFILE_NAME);
         UARTprintf("The following is a list of commands:\n"
                 "GO - Run Maze\n");
         UARTgets(command, strlen(command) + 1);
@@ -742,7 +2910,7 @@ void lightSensorCalculation(void) {
         // Start run
         if (!strcmp(command, "GO"))
         {
-            PWMOutputState(PWM1_BASE, PWM_OUT_2_BIT | PWM_OUT_3_BIT, true);
+            startRun();
             // Initialize RTOS
             BIOS_start();
         }
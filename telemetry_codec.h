@@ -0,0 +1,208 @@
+/*
+ *************************************************************************************
+ * ECE 4437
+ * TEAM 5: DANK ERRORS
+ *
+ * TELEMETRY CODEC (ZIG-ZAG DELTA + VARINT)
+ *
+ * Packs telemetry samples into delta-coded frames and unpacks them again.
+ *************************************************************************************
+ */
+
+/*
+ *************************************************************************************
+ * FRAME FORMAT
+ *
+ * [SYNC 0xA5] [channel] [samples] [payload bytes] [payload ...] [checksum]
+ *
+ * payload: one varint per sample
+ *  delta    = value - previous value (previous = 0 for the first sample, so every
+ *             frame decodes on its own and a lost frame loses only itself)
+ *  zig-zag  = delta folded to unsigned: 0, -1, 1, -2, 2 ... -> 0, 1, 2, 3, 4 ...
+ *  varint   = LEB128, 7 bits per byte, low bits first, bit 7 set = more bytes
+ *
+ * checksum: XOR of every byte from channel to the end of the payload
+ *
+ * SYNC is not ASCII, so frames can share the UART with UARTprintf() text and the
+ *  decoder finds them by scanning for SYNC and checking the checksum.
+ *
+ * A slowly changing value costs 1 byte per sample instead of "%X, " (4-6 bytes).
+ *************************************************************************************
+ */
+#ifndef TELEMETRY_CODEC_H
+#define TELEMETRY_CODEC_H
+
+#include <stdint.h>
+
+#define CODEC_SYNC          0xA5
+#define CODEC_HEADER        4       //sync, channel, samples, payload bytes
+#define CODEC_VARINT_MAX    5       //bytes for a 32-bit varint
+#define CODEC_MAX_SAMPLES   48      //payload bytes must fit in one byte
+#define CODEC_FRAME_MAX     (CODEC_HEADER + CODEC_VARINT_MAX * CODEC_MAX_SAMPLES + 1)
+
+/*
+ *************************************************************************************
+ * CHANNELS
+ *
+ * The frame's channel byte. Rates and depths are set in the firmware, the numbers
+ *  here are the wire format and must match tools/telemetry_decode.c.
+ *************************************************************************************
+ */
+#define CHANNEL_ERROR       0       //|right - target| [ADC code]
+#define CHANNEL_RIGHT       1       //right sensor seen by PID() [ADC code]
+#define CHANNEL_FRONT       2       //front sensor seen by PID() [ADC code]
+#define CHANNEL_PID         3       //pidRight, truncated
+#define CHANNEL_BRANCH      4       //BRANCH_* taken
+#define CHANNEL_DUTY_LEFT   5       //[%]
+#define CHANNEL_DUTY_RIGHT  6       //[%]
+#define CHANNEL_DIRECTION   7       //bit 0 = left forward, bit 1 = right forward
+#define CHANNEL_LIGHT       8       //light sensor decay count
+#define CHANNELS            9
+
+typedef struct {
+    uint8_t bytes[CODEC_FRAME_MAX];
+    uint32_t length;        //bytes used so far
+    int32_t last;           //previous sample, for the delta
+} CodecFrame;
+
+/*
+ *************************************************************************************
+ * PRIMITIVES
+ *************************************************************************************
+ */
+static inline uint32_t zigzagEncode(int32_t value) {
+    return ((uint32_t)value << 1) ^ (uint32_t)(value >> 31);
+}
+
+static inline int32_t zigzagDecode(uint32_t value) {
+    return (int32_t)(value >> 1) ^ -(int32_t)(value & 1);
+}
+
+// Writes value as LEB128, returns the number of bytes written (1 to 5)
+static inline uint32_t varintPut(uint8_t *out, uint32_t value) {
+    uint32_t n = 0;
+
+    while (value >= 0x80) {
+        out[n++] = (uint8_t)(value | 0x80);
+        value >>= 7;
+    }
+    out[n++] = (uint8_t)value;
+    return n;
+}
+
+// Reads one LEB128 value, returns bytes used or 0 if it runs past end
+static inline uint32_t varintGet(const uint8_t *in, uint32_t available, uint32_t *value) {
+    uint32_t result = 0;
+    uint32_t n = 0;
+    uint32_t shift = 0;
+
+    while ((n < available) && (n < CODEC_VARINT_MAX)) {
+        result |= (uint32_t)(in[n] & 0x7F) << shift;
+        if ((in[n++] & 0x80) == 0) {
+            *value = result;
+            return n;
+        }
+        shift += 7;
+    }
+    return 0;
+}
+
+/*
+ *************************************************************************************
+ * ENCODER (streaming, one sample at a time)
+ *************************************************************************************
+ */
+static inline void codecBegin(CodecFrame *frame, uint8_t channel) {
+    frame->bytes[0] = CODEC_SYNC;
+    frame->bytes[1] = channel;
+    frame->bytes[2] = 0;
+    frame->bytes[3] = 0;
+    frame->length = CODEC_HEADER;
+    frame->last = 0;
+}
+
+// Returns 0 when the frame is full, call codecEnd() and start a new one
+static inline int codecPut(CodecFrame *frame, int32_t value) {
+    if (frame->bytes[2] >= CODEC_MAX_SAMPLES) {
+        return 0;
+    }
+    frame->length += varintPut(&frame->bytes[frame->length],
+                               zigzagEncode(value - frame->last));
+    frame->last = value;
+    ++frame->bytes[2];
+    return 1;
+}
+
+// Fills in the payload size and checksum, returns the bytes to send
+static inline uint32_t codecEnd(CodecFrame *frame) {
+    uint8_t checksum = 0;
+    uint32_t n;
+
+    frame->bytes[3] = (uint8_t)(frame->length - CODEC_HEADER);
+    for (n = 1; n < frame->length; ++n) {
+        checksum ^= frame->bytes[n];
+    }
+    frame->bytes[frame->length++] = checksum;
+    return frame->length;
+}
+
+/*
+ *************************************************************************************
+ * DECODER
+ *************************************************************************************
+ */
+    /*
+     *********************************************************************************
+     * Decodes one frame starting at in[0] == CODEC_SYNC.
+     *  Returns the frame length, 0 if more bytes are needed, or -1 if this is not
+     *      a valid frame (bad checksum or payload), skip one byte and rescan.
+     *  Never asks for more than CODEC_FRAME_MAX bytes.
+     *********************************************************************************
+     */
+static inline int codecDecode(const uint8_t *in, uint32_t available,
+                              uint8_t *channel, int32_t *values, uint32_t *count) {
+    uint32_t samples, payload, n, used, pos;
+    uint32_t zigzag;
+    uint8_t checksum = 0;
+    int32_t last = 0;
+
+    if (available < CODEC_HEADER) {
+        return 0;
+    }
+    samples = in[2];
+    payload = in[3];
+    // A payload longer than the encoder can write is noise that happens to follow
+    //  a SYNC byte, waiting for it would hold more than CODEC_FRAME_MAX bytes
+    if ((samples > CODEC_MAX_SAMPLES) || (payload < samples)
+            || (payload > CODEC_VARINT_MAX * CODEC_MAX_SAMPLES)) {
+        return -1;
+    }
+    if (available < CODEC_HEADER + payload + 1) {
+        return 0;
+    }
+    for (n = 1; n < CODEC_HEADER + payload; ++n) {
+        checksum ^= in[n];
+    }
+    if (checksum != in[CODEC_HEADER + payload]) {
+        return -1;
+    }
+
+    pos = CODEC_HEADER;
+    for (n = 0; n < samples; ++n) {
+        used = varintGet(&in[pos], CODEC_HEADER + payload - pos, &zigzag);
+        if (used == 0) {
+            return -1;
+        }
+        pos += used;
+        last += zigzagDecode(zigzag);
+        values[n] = last;
+    }
+    if (pos != CODEC_HEADER + payload) {
+        return -1;
+    }
+    *channel = in[1];
+    *count = samples;
+    return (int)(CODEC_HEADER + payload + 1);
+}
+
+#endif
@@ -0,0 +1,158 @@
+/*
+ *************************************************************************************
+ * ECE 4437
+ * TEAM 5: DANK ERRORS
+ *
+ * BRANCH COVERAGE REPORT
+ *
+ * Host program, build from the repo root:
+ *  gcc -O2 -o branch_report tools/branch_report.c
+ *
+ * Reads a PuTTY log with the "BR" or RUN COMPLETED dump of printBranches():
+ *  ./branch_report < putty.log
+ *      prints the last dump again and flags chattering branch pairs
+ *************************************************************************************
+ */
+#include <stdio.h>
+#include <string.h>
+
+/*
+ *************************************************************************************
+ * DEFINING CONSTANTS
+ *************************************************************************************
+ */
+#define BRANCHES            7       //same as the firmware
+#define LINE_SIZE           256
+#define CHATTER_CHANGES     5       //both directions at least this often
+#define CHATTER_DWELL_MS    150     //and both mean visits shorter than this
+
+// Same order as BRANCH_* in team5_dank_errors_final.c
+static const char *branchNames[BRANCHES] = {
+    "NONE", "UTURN", "LEFT", "RIGHT", "SHARP", "STRAIGHT", "SPECIAL"
+};
+
+// Thresholds in robot_profile.h that decide whether PID() enters each branch
+static const char *branchThresholds[BRANCHES] = {
+    "(no branch matched)",
+    "PID_UTURN_MAX, FRONT_UTURN_ADC",
+    "PID_LEFT_MIN, FRONT_CLEAR_ADC",
+    "PID_RIGHT_MIN, PID_RIGHT_MAX, FRONT_CLEAR_ADC",
+    "PID_SHARP_MAX, FRONT_SHARP_ADC",
+    "PID_STRAIGHT_BAND, FRONT_STRAIGHT_ADC",
+    "PID_SPECIAL_MIN, FRONT_CLEAR_ADC, FRONT_SPECIAL_ADC",
+};
+
+/*
+ *************************************************************************************
+ * PARSED DUMP
+ *************************************************************************************
+ */
+static unsigned hits[BRANCHES];
+static unsigned visits[BRANCHES];
+static unsigned dwell[BRANCHES];        //mean [ms]
+static unsigned longest[BRANCHES];      //[ms]
+static unsigned transitions[BRANCHES][BRANCHES];
+
+static int findBranch(const char *name) {
+    int n;
+
+    for (n = 0; n < BRANCHES; ++n) {
+        if (!strcmp(name, branchNames[n])) {
+            return n;
+        }
+    }
+    return -1;
+}
+
+    /*
+     *********************************************************************************
+     *  Keeps the last complete dump in the log, earlier "BR" dumps are replaced.
+     *  Returns 1 if a BRANCHES and a TRANSITIONS block were found.
+     *********************************************************************************
+     */
+static int readDump(FILE *in) {
+    char line[LINE_SIZE];
+    char name[32];
+    unsigned row[BRANCHES];
+    int inTransitions = 0, found = 0, rows = 0;
+    int branch, n;
+
+    while (fgets(line, sizeof(line), in) != NULL) {
+        if (!strncmp(line, "BRANCHES:", 9)) {
+            inTransitions = 0;
+            continue;
+        }
+        if (!strncmp(line, "TRANSITIONS", 11)) {
+            inTransitions = 1;
+            rows = 0;
+            continue;
+        }
+        if (sscanf(line, " %31[A-Z]:", name) != 1 || (branch = findBranch(name)) < 0) {
+            continue;
+        }
+        if (!inTransitions) {
+            sscanf(line, " %*[A-Z]: hits %u, visits %u, mean dwell %u ms, longest %u ms",
+                   &hits[branch], &visits[branch], &dwell[branch], &longest[branch]);
+            continue;
+        }
+        if (sscanf(line, " %*[A-Z]: %u %u %u %u %u %u %u", &row[0], &row[1], &row[2],
+                   &row[3], &row[4], &row[5], &row[6]) == BRANCHES) {
+            for (n = 0; n < BRANCHES; ++n) {
+                transitions[branch][n] = row[n];
+            }
+            if (++rows == BRANCHES) {
+                found = 1;
+                inTransitions = 0;
+            }
+        }
+    }
+    return found;
+}
+
+/*
+ *************************************************************************************
+ * MAIN
+ *************************************************************************************
+ */
+int main(void) {
+    unsigned total = 0;
+    int from, to, flagged = 0;
+
+    if (!readDump(stdin)) {
+        fprintf(stderr, "no BRANCHES / TRANSITIONS dump found\n");
+        return 1;
+    }
+
+    for (from = 0; from < BRANCHES; ++from) {
+        total += hits[from];
+    }
+    printf("%-9s %8s %6s %7s %9s %9s\n", "branch", "hits", "share", "visits",
+           "dwell ms", "longest");
+    for (from = 0; from < BRANCHES; ++from) {
+        printf("%-9s %8u %5u%% %7u %9u %9u%s\n", branchNames[from], hits[from],
+               total ? 100 * hits[from] / total : 0, visits[from], dwell[from],
+               longest[from], hits[from] ? "" : "   never taken");
+    }
+
+    // A pair chatters when it flips both ways often and neither side settles
+    printf("\n");
+    for (from = 0; from < BRANCHES; ++from) {
+        for (to = from + 1; to < BRANCHES; ++to) {
+            if ((transitions[from][to] < CHATTER_CHANGES) ||
+                (transitions[to][from] < CHATTER_CHANGES) ||
+                (dwell[from] >= CHATTER_DWELL_MS) || (dwell[to] >= CHATTER_DWELL_MS)) {
+                continue;
+            }
+            printf("CHATTER %s <-> %s: %u / %u changes, mean dwell %u / %u ms\n",
+                   branchNames[from], branchNames[to],
+                   transitions[from][to], transitions[to][from], dwell[from], dwell[to]);
+            printf("  check %s\n  and   %s\n", branchThresholds[from], branchThresholds[to]);
+            ++flagged;
+        }
+    }
+    if (flagged == 0) {
+        printf("no chattering pairs (%d+ changes both ways, visits < %d ms)\n",
+               CHATTER_CHANGES, CHATTER_DWELL_MS);
+    }
+    return 0;
+}
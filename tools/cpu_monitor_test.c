@@ -0,0 +1,119 @@
+/*
+ *************************************************************************************
+ * ECE 4437
+ * TEAM 5: DANK ERRORS
+ *
+ * CPU MONITOR TEST
+ *
+ * Host program, build from the repo root:
+ *  gcc -O2 -I. -o cpu_monitor_test tools/cpu_monitor_test.c
+ *
+ * Drives cpu_monitor.h with a simulated cycle counter the way the firmware does:
+ *  cpuLoadTick() at the start of every PID_Clk tick, the tick's work, then the
+ *      idle loop calling cpuIdle() until the next tick.
+ *  ./cpu_monitor_test
+ *      checks the load at 0 .. 100% busy, across the DWT_CYCCNT wrap, and the
+ *          deadline checks, prints PASS or exits 1 if any check fails
+ *************************************************************************************
+ */
+#include <stdio.h>
+#include <stdint.h>
+#include "cpu_monitor.h"
+
+/*
+ *************************************************************************************
+ * DEFINING CONSTANTS
+ *************************************************************************************
+ */
+#define CLOCK_HZ            40000000 //SysCtlClockGet(), also the load window [cycles]
+#define TICK_HZ             20      //PID_Clk
+#define TICK_CYCLES         (CLOCK_HZ / TICK_HZ)
+#define IDLE_CALL_CYCLES    200     //one pass of the BIOS idle loop
+#define SECONDS             3
+
+static int failures = 0;
+
+static void check(int ok, const char *what, long got, long expected) {
+    if (!ok) {
+        fprintf(stderr, "FAIL: %s: got %ld, expected %ld\n", what, got, expected);
+        ++failures;
+    }
+}
+
+/*
+ *************************************************************************************
+ * CPU LOAD
+ *************************************************************************************
+ */
+    /*
+     *********************************************************************************
+     *  SECONDS of ticks with busyPercent of every tick spent in the tick's work,
+     *      starting the cycle counter at start and the idle total at idleStart.
+     *          Every window after the first one must close and read busyPercent,
+     *              give or take 1%.
+     *********************************************************************************
+     */
+static void loadCase(const char *name, uint32_t start, uint32_t idleStart,
+                     uint32_t busyPercent) {
+    CpuMonitor cpu;
+    uint32_t now = start, tickStart;
+    int tick, windows = 0;
+
+    resetCpuMonitor(&cpu, now, CLOCK_HZ);
+    cpu.idleCycles = idleStart;
+    cpu.idleAtWindow = idleStart;
+    for (tick = 0; tick < SECONDS * TICK_HZ; ++tick) {
+        tickStart = now;
+        windows += cpuLoadTick(&cpu, now);
+        now += TICK_CYCLES / 100 * busyPercent;
+        while (cyclesSince(now, tickStart) + IDLE_CALL_CYCLES <= TICK_CYCLES) {
+            now += IDLE_CALL_CYCLES;
+            cpuIdle(&cpu, now);
+        }
+        now = tickStart + TICK_CYCLES;
+    }
+
+    printf("%-26s busy %3u%%: load %3u%% (peak %3u%%), %d windows\n", name, busyPercent,
+           cpu.load, cpu.loadPeak, windows);
+    check(windows == SECONDS - 1, name, windows, SECONDS - 1);
+    check((cpu.load + 1 >= busyPercent) && (cpu.load <= busyPercent + 1), name,
+          cpu.load, busyPercent);
+}
+
+/*
+ *************************************************************************************
+ * DEADLINES
+ *************************************************************************************
+ */
+static void deadlineCase(const char *name, uint32_t lastStart) {
+    const uint32_t period = TICK_CYCLES;
+    const uint32_t slack = period + period / 100 * DEADLINE_SLACK;
+
+    check(!releasedLate(lastStart + period, lastStart, period), name, 1, 0);
+    check(!releasedLate(lastStart + slack, lastStart, period), name, 1, 0);
+    check(releasedLate(lastStart + slack + 1, lastStart, period), name, 0, 1);
+    check(!ranPastRelease(lastStart, lastStart + period, period), name, 1, 0);
+    check(ranPastRelease(lastStart, lastStart + period + 1, period), name, 0, 1);
+}
+
+int main(void) {
+    static const uint32_t busy[] = { 0, 30, 75, 99, 100 };
+    unsigned n;
+
+    for (n = 0; n < sizeof(busy) / sizeof(busy[0]); ++n) {
+        loadCase("load", 0, 0, busy[n]);
+        // The counter wraps in the middle of the first window
+        loadCase("load across the wrap", 0xFFFFFFFFu - CLOCK_HZ / 2, 0, busy[n]);
+        // The idle total wraps in the second window
+        loadCase("idle total across the wrap", 0, 0xFFFFFFFFu - CLOCK_HZ * 3 / 2, busy[n]);
+    }
+    deadlineCase("deadline", 0);
+    deadlineCase("deadline across the wrap", 0xFFFFFFFFu - TICK_CYCLES / 4);
+
+    if (failures > 0) {
+        fprintf(stderr, "%d checks failed\n", failures);
+        return 1;
+    }
+    printf("PASS\n");
+    return 0;
+}
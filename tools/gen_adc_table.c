@@ -0,0 +1,94 @@
+/*
+ *************************************************************************************
+ * ECE 4437
+ * TEAM 5: DANK ERRORS
+ *
+ * GENERATES adc_distance_table.h
+ *
+ * Host program, build and run from the repo root:
+ *  gcc -O2 -o gen_adc_table tools/gen_adc_table.c
+ *  ./gen_adc_table > adc_distance_table.h
+ *************************************************************************************
+ */
+#include <stdio.h>
+
+/*
+ *************************************************************************************
+ * SENSOR CURVE
+ *************************************************************************************
+ */
+    /*
+     *********************************************************************************
+     *  distance [cm] = 13 / volts - 1, volts = code * 3 / 4096
+     *      => distance [mm] = 532480 / (3 * code) - 10
+     *
+     *  Same curve as distanceSensorCalculations() in the milestone 8 build.
+     *********************************************************************************
+     */
+#define ADC_CODES       4096
+#define MAX_MM          800     //readings beyond this are treated as "no wall"
+
+static unsigned int codeToMM(unsigned int code) {
+    double mm;
+
+    if (code == 0) {
+        return MAX_MM;
+    }
+    mm = 532480.0 / (3.0 * code) - 10.0;
+    if (mm < 0) {
+        mm = 0;
+    }
+    if (mm > MAX_MM) {
+        mm = MAX_MM;
+    }
+    return (unsigned int)(mm + 0.5);
+}
+
+static unsigned int mmToCode(unsigned int mm) {
+    double code = 532480.0 / (3.0 * (mm + 10.0));
+
+    if (code > ADC_CODES - 1) {
+        code = ADC_CODES - 1;
+    }
+    return (unsigned int)(code + 0.5);
+}
+
+/*
+ *************************************************************************************
+ * MAIN
+ *************************************************************************************
+ */
+int main(void) {
+    unsigned int n;
+
+    printf("/*\n"
+           " *************************************************************************************\n"
+           " * ADC CODE <-> DISTANCE TABLES\n"
+           " *\n"
+           " * GENERATED BY tools/gen_adc_table.c - DO NOT EDIT\n"
+           " *\n"
+           " * distance [mm] = 532480 / (3 * code) - 10, clamped to 0..%d [mm]\n"
+           " *************************************************************************************\n"
+           " */\n", MAX_MM);
+    printf("#ifndef ADC_DISTANCE_TABLE_H\n#define ADC_DISTANCE_TABLE_H\n\n");
+    printf("#include <stdint.h>\n\n");
+    printf("#define ADC_TABLE_MAX_MM    %d\n\n", MAX_MM);
+    printf("// Compile-time conversion for thresholds, rounded to the nearest code\n");
+    printf("#define MM_TO_ADC(mm)       ((1064960 / (3 * ((mm) + 10)) + 1) / 2)\n\n");
+
+    printf("// ADC code -> distance [mm]\n");
+    printf("static const uint16_t adcToMM[%d] = {", ADC_CODES);
+    for (n = 0; n < ADC_CODES; ++n) {
+        printf("%s%u,", (n % 16) ? " " : "\n    ", codeToMM(n));
+    }
+    printf("\n};\n\n");
+
+    printf("// distance [mm] -> ADC code\n");
+    printf("static const uint16_t mmToADC[ADC_TABLE_MAX_MM + 1] = {");
+    for (n = 0; n <= MAX_MM; ++n) {
+        printf("%s%u,", (n % 16) ? " " : "\n    ", mmToCode(n));
+    }
+    printf("\n};\n\n");
+    printf("#endif\n");
+    return 0;
+}
@@ -0,0 +1,522 @@
+/*
+ *************************************************************************************
+ * ECE 4437
+ * TEAM 5: DANK ERRORS
+ *
+ * KERNEL MICROBENCHMARKS
+ *
+ * Times the control tick's kernels on the host, from the same headers the
+ *  firmware builds (wall_control.h, line_sensor.h, telemetry_codec.h,
+ *  adc_distance_table.h). Build from the repo root:
+ *  gcc -O2 -I. -o kernel_bench tools/kernel_bench.c -lm
+ *
+ *  ./kernel_bench [-r repeats] [-o after.json] [-c before.json]
+ *      runs every kernel, prints a table and optionally writes JSON
+ *      -c  compares against an earlier JSON, so a change comes with
+ *          before / after numbers
+ *  ./kernel_bench -k pid -n 1000000
+ *      runs one kernel n times without timing, for instruction counters:
+ *      perf stat -e instructions,cycles ./kernel_bench -k pid -n 1000000
+ *
+ * Kernels, each timed per call:
+ *  pid             PID() without the pin writes: planner, gains, PID, branch, duties
+ *  light           classifyLight() on one decay count
+ *  barcode         decodeBarcode() on one decay count, what the firmware runs
+ *  light_cal       updateLightCalibration() on one decay count (USE_LIGHT_CAL),
+ *                  the Otsu split every LIGHT_CAL_UPDATE calls included
+ *  line_array      one reflectance array read: darkestDecay(), linePosition(),
+ *                  classifyLight() (USE_LINE_ARRAY)
+ *  adc_convert     senseGroup()'s lookups: 2 codes -> [mm] -> codes, as distanceToADC()
+ *  format_text     one "%X, " sample (snprintf stands in for UARTprintf())
+ *  format_codec    one sample through codecPut(), codecEnd() every BUFFER_SIZE
+ *
+ * Cortex-M instruction counts under QEMU (Cortex-M4 with FPU like the TM4C123):
+ *  arm-none-eabi-gcc -O2 -mcpu=cortex-m4 -mthumb -mfloat-abi=hard -mfpu=fpv4-sp-d16 \
+ *      -I. --specs=rdimon.specs -o kernel_bench.elf tools/kernel_bench.c -lm
+ *  qemu-system-arm -M mps2-an386 -nographic -kernel kernel_bench.elf \
+ *      -semihosting-config enable=on,target=native,arg=kb,arg=-k,arg=pid,arg=-n,arg=100000 \
+ *      -plugin libinsn.so -d plugin
+ *  Run once more with -n 0, (difference) / n = instructions per call. The Stellaris
+ *      machine (-M lm3s6965evb, -mcpu=cortex-m3, soft float) works the same but
+ *          counts the float kernels without an FPU.
+ *************************************************************************************
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include "adc_distance_table.h"
+#include "robot_profile.h"
+#include "telemetry_codec.h"
+#include "wall_control.h"
+#include "line_sensor.h"
+
+#if defined(__ARM_ARCH_7M__) || defined(__ARM_ARCH_7EM__)
+#define BENCH_TARGET        1       //bare metal Cortex-M, count mode only
+#else
+#define BENCH_TARGET        0
+#include <time.h>
+#endif
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define HAVE_TSC            1
+#else
+#define HAVE_TSC            0
+#endif
+
+/*
+ *************************************************************************************
+ * DEFINING CONSTANTS
+ *************************************************************************************
+ */
+#define INPUTS              4096    //recorded-like inputs, cycled through (power of 2)
+#define BUFFER_SIZE         20      //samples per ERROR line, same as the firmware
+#define REPEATS_DEFAULT     21
+#define REPEATS_MAX         101
+#define SAMPLE_SECONDS      0.002   //each timed sample runs at least this long
+#define LINE_SIZE           256
+
+/*
+ *************************************************************************************
+ * INPUTS
+ *************************************************************************************
+ */
+static int rightCodes[INPUTS];
+static int frontCodes[INPUTS];
+static uint32_t decayCounts[INPUTS];
+static volatile uint32_t sink;          //keeps the results alive
+
+    /*
+     *********************************************************************************
+     *  Random walks around the target for the IR sensors, with the occasional
+     *      opening on the right and wall ahead so every branch is taken.
+     *  Decay counts: white floor with thin and thick black lines.
+     *********************************************************************************
+     */
+static void makeInputs(void) {
+    int right = TARGET_VALUE, front = MM_TO_ADC(300);
+    int n;
+
+    srand(4437);
+    for (n = 0; n < INPUTS; ++n) {
+        right += (rand() % 121) - 60;
+        front += (rand() % 81) - 40;
+        if ((rand() % 64) == 0) {
+            right = MM_TO_ADC(400);
+        }
+        if ((rand() % 64) == 0) {
+            front = MM_TO_ADC(70);
+        }
+        right = (right < 100) ? 100 : (right > 4000) ? 4000 : right;
+        front = (front < 100) ? 100 : (front > 4000) ? 4000 : front;
+        rightCodes[n] = right;
+        frontCodes[n] = front;
+        decayCounts[n] = ((n % 200) < 5) || ((n % 1000) < 15) ?
+                         LIGHT_BLACK + 1000 + rand() % 500 : 500 + rand() % 500;
+    }
+}
+
+/*
+ *************************************************************************************
+ * KERNELS
+ *************************************************************************************
+ */
+static uint32_t kernelPid(uint32_t calls) {
+    static const SpeedConfig config = SPEED_CONFIG;
+    static SpeedState state = { 100.0f, 0 };
+    static int lastError, branch = BRANCH_STRAIGHT, left = PWM_ADJUST * DUTY_ONE,
+               right = PWM_ADJUST * DUTY_ONE;
+    uint32_t sum = 0, n;
+
+    for (n = 0; n < calls; ++n) {
+        int error = rightCodes[n & (INPUTS - 1)] - TARGET_VALUE;
+        int front = frontCodes[n & (INPUTS - 1)];
+        float percent, kp, kd, pid;
+
+        percent = planSpeed(&config, &state, adcToMM[front & 0xFFF], error, branch,
+                            1.0f / 20);
+        scheduleGains(&config, percent, &kp, &kd);
+        pid = wallPid(error, lastError, kp, kd, 1.0f / 20);
+        lastError = error;
+        branch = selectBranch(pid, front);
+        branchDuties(branch, percent, &left, &right);
+        sum += (uint32_t)(left * 3 + right + branch);
+    }
+    return sum;
+}
+
+static uint32_t kernelLight(uint32_t calls) {
+    static int blackCount;
+    uint32_t sum = 0, n;
+
+    for (n = 0; n < calls; ++n) {
+        sum += (uint32_t)classifyLight(&blackCount, decayCounts[n & (INPUTS - 1)]);
+    }
+    return sum + (uint32_t)blackCount;
+}
+
+static uint32_t kernelBarcode(uint32_t calls) {
+    static BarcodeState state;
+    uint32_t sum = 0, n;
+
+    for (n = 0; n < calls; ++n) {
+        sum += (uint32_t)decodeBarcode(&state, decayCounts[n & (INPUTS - 1)], LIGHT_BLACK);
+    }
+    return sum + state.code;
+}
+
+static uint32_t kernelLightCal(uint32_t calls) {
+    static LightCalibration cal;
+    static int ready;
+    uint32_t n;
+
+    if (!ready) {
+        resetLightCalibration(&cal);
+        ready = 1;
+    }
+    for (n = 0; n < calls; ++n) {
+        updateLightCalibration(&cal, decayCounts[n & (INPUTS - 1)]);
+    }
+    return cal.threshold + cal.samples;
+}
+
+// Consecutive decay counts stand in for the array's elements
+static uint32_t kernelLineArray(uint32_t calls) {
+    static int blackCount;
+    uint32_t sum = 0, n;
+    int position = 0;
+
+    for (n = 0; n < calls; ++n) {
+        const uint32_t *decays = &decayCounts[(n * LINE_ARRAY_SIZE) & (INPUTS - 1)];
+
+        sum += (uint32_t)linePosition(decays, LIGHT_WHITE, LIGHT_BLACK, &position) +
+               (uint32_t)position;
+        sum += (uint32_t)classifyLight(&blackCount, darkestDecay(decays));
+    }
+    return sum + (uint32_t)blackCount;
+}
+
+// Same clamp and rounding as distanceToADC() in the firmware
+static uint32_t toCode(float distance) {
+    if (distance <= 0) {
+        return mmToADC[0];
+    }
+    if (distance >= ADC_TABLE_MAX_MM) {
+        return mmToADC[ADC_TABLE_MAX_MM];
+    }
+    return mmToADC[(uint32_t)(distance + 0.5f)];
+}
+
+static uint32_t kernelAdc(uint32_t calls) {
+    uint32_t sum = 0, n;
+
+    for (n = 0; n < calls; ++n) {
+        float right = adcToMM[rightCodes[n & (INPUTS - 1)] & 0xFFF];
+        float front = adcToMM[frontCodes[n & (INPUTS - 1)] & 0xFFF];
+
+        sum += toCode(right) + toCode(front);
+    }
+    return sum;
+}
+
+static uint32_t kernelFormatText(uint32_t calls) {
+    char text[16];
+    uint32_t sum = 0, n;
+
+    for (n = 0; n < calls; ++n) {
+        sum += (uint32_t)snprintf(text, sizeof(text), "%X, ",
+                                  (unsigned)abs(rightCodes[n & (INPUTS - 1)] - TARGET_VALUE));
+    }
+    return sum + (uint8_t)text[0];
+}
+
+static uint32_t kernelFormatCodec(uint32_t calls) {
+    static CodecFrame frame;
+    uint32_t sum = 0, n, samples = 0;
+
+    codecBegin(&frame, CHANNEL_ERROR);
+    for (n = 0; n < calls; ++n) {
+        codecPut(&frame, abs(rightCodes[n & (INPUTS - 1)] - TARGET_VALUE));
+        if (++samples == BUFFER_SIZE) {
+            sum += codecEnd(&frame);
+            codecBegin(&frame, CHANNEL_ERROR);
+            samples = 0;
+        }
+    }
+    return sum + frame.length;
+}
+
+typedef struct {
+    const char *name;
+    const char *unit;               //what one call is
+    uint32_t (*run)(uint32_t calls);
+} Kernel;
+
+static const Kernel kernels[] = {
+    { "pid",          "control tick", kernelPid },
+    { "light",        "sample",       kernelLight },
+    { "barcode",      "sample",       kernelBarcode },
+    { "light_cal",    "sample",       kernelLightCal },
+    { "line_array",   "sample",       kernelLineArray },
+    { "adc_convert",  "sense tick",   kernelAdc },
+    { "format_text",  "sample",       kernelFormatText },
+    { "format_codec", "sample",       kernelFormatCodec },
+};
+#define KERNELS             ((int)(sizeof(kernels) / sizeof(kernels[0])))
+
+static int findKernel(const char *name) {
+    int n;
+
+    for (n = 0; n < KERNELS; ++n) {
+        if (!strcmp(name, kernels[n].name)) {
+            return n;
+        }
+    }
+    return -1;
+}
+
+#if !BENCH_TARGET
+/*
+ *************************************************************************************
+ * TIMING
+ *************************************************************************************
+ */
+typedef struct {
+    uint32_t calls;                 //per sample
+    double nsMin;                   //per call
+    double nsMedian;
+    double nsMad;                   //median absolute deviation
+    double tscMedian;               //TSC ticks per call, 0 without a TSC
+} Timing;
+
+static double seconds(void) {
+    struct timespec now;
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return now.tv_sec + now.tv_nsec * 1e-9;
+}
+
+static int compareDouble(const void *a, const void *b) {
+    double x = *(const double *)a, y = *(const double *)b;
+
+    return (x > y) - (x < y);
+}
+
+static double median(double *values, int count) {
+    qsort(values, count, sizeof(double), compareDouble);
+    return (count % 2) ? values[count / 2] : (values[count / 2 - 1] + values[count / 2]) / 2;
+}
+
+    /*
+     *********************************************************************************
+     *  Doubles the call count until one sample takes SAMPLE_SECONDS, then takes
+     *      repeats samples. The median and MAD ignore the odd sample hit by
+     *          an interrupt or a migration, min is the best case.
+     *********************************************************************************
+     */
+static Timing timeKernel(const Kernel *kernel, int repeats) {
+    double ns[REPEATS_MAX], tsc[REPEATS_MAX], deviation[REPEATS_MAX];
+    Timing timing;
+    double start;
+    int n;
+
+    memset(&timing, 0, sizeof(timing));
+    kernel->run(INPUTS); //warm the caches and the branch predictor
+    for (timing.calls = 1024; ; timing.calls *= 2) {
+        start = seconds();
+        sink += kernel->run(timing.calls);
+        if (seconds() - start >= SAMPLE_SECONDS) {
+            break;
+        }
+    }
+
+    for (n = 0; n < repeats; ++n) {
+#if HAVE_TSC
+        uint64_t ticks = __rdtsc();
+#endif
+        start = seconds();
+        sink += kernel->run(timing.calls);
+        ns[n] = (seconds() - start) * 1e9 / timing.calls;
+#if HAVE_TSC
+        tsc[n] = (double)(__rdtsc() - ticks) / timing.calls;
+#else
+        tsc[n] = 0;
+#endif
+    }
+    timing.nsMedian = median(ns, repeats);
+    timing.nsMin = ns[0];
+    for (n = 0; n < repeats; ++n) {
+        deviation[n] = fabs(ns[n] - timing.nsMedian);
+    }
+    timing.nsMad = median(deviation, repeats);
+    timing.tscMedian = median(tsc, repeats);
+    return timing;
+}
+
+/*
+ *************************************************************************************
+ * JSON
+ *************************************************************************************
+ */
+    /*
+     *********************************************************************************
+     * One kernel per line so readBaseline() can scan it back without a parser.
+     *********************************************************************************
+     */
+static void writeJson(FILE *out, const Timing *timings, int repeats) {
+    int n;
+
+    fprintf(out, "{\n  \"profile\": \"%s\",\n  \"compiler\": \"%s\",\n  \"repeats\": %d,\n",
+            PROFILE_NAME, __VERSION__, repeats);
+    fprintf(out, "  \"kernels\": [\n");
+    for (n = 0; n < KERNELS; ++n) {
+        fprintf(out, "    {\"name\": \"%s\", \"unit\": \"%s\", \"calls\": %u, "
+                "\"ns_min\": %.3f, \"ns_median\": %.3f, \"ns_mad\": %.3f, ",
+                kernels[n].name, kernels[n].unit, timings[n].calls, timings[n].nsMin,
+                timings[n].nsMedian, timings[n].nsMad);
+        if (HAVE_TSC) {
+            fprintf(out, "\"tsc_median\": %.2f}", timings[n].tscMedian);
+        }
+        else {
+            fprintf(out, "\"tsc_median\": null}");
+        }
+        fprintf(out, "%s\n", (n + 1 < KERNELS) ? "," : "");
+    }
+    fprintf(out, "  ]\n}\n");
+}
+
+// Median and MAD of each kernel in an earlier JSON, -1 where it is missing
+static int readBaseline(const char *path, double *medians, double *mads) {
+    char line[LINE_SIZE], name[32];
+    double nsMin, nsMedian, nsMad;
+    unsigned calls;
+    FILE *in = fopen(path, "r");
+    int n;
+
+    if (in == NULL) {
+        perror(path);
+        return -1;
+    }
+    for (n = 0; n < KERNELS; ++n) {
+        medians[n] = -1;
+        mads[n] = 0;
+    }
+    while (fgets(line, sizeof(line), in) != NULL) {
+        if ((sscanf(line, " {\"name\": \"%31[^\"]\", \"unit\": \"%*[^\"]\", \"calls\": %u, "
+                    "\"ns_min\": %lf, \"ns_median\": %lf, \"ns_mad\": %lf",
+                    name, &calls, &nsMin, &nsMedian, &nsMad) == 5) &&
+            ((n = findKernel(name)) >= 0)) {
+            medians[n] = nsMedian;
+            mads[n] = nsMad;
+        }
+    }
+    fclose(in);
+    return 0;
+}
+#endif
+
+/*
+ *************************************************************************************
+ * MAIN
+ *************************************************************************************
+ */
+int main(int argc, char **argv) {
+    const char *only = NULL;
+    long calls = -1;
+#if !BENCH_TARGET
+    const char *jsonPath = NULL, *baselinePath = NULL;
+    double baseMedian[KERNELS], baseMad[KERNELS];
+    Timing timings[KERNELS];
+    int repeats = REPEATS_DEFAULT;
+    FILE *json;
+#endif
+    int n;
+
+    for (n = 1; n < argc; ++n) {
+        if (!strcmp(argv[n], "-k") && (n + 1 < argc)) {
+            only = argv[++n];
+        }
+        else if (!strcmp(argv[n], "-n") && (n + 1 < argc)) {
+            calls = atol(argv[++n]);
+        }
+#if !BENCH_TARGET
+        else if (!strcmp(argv[n], "-r") && (n + 1 < argc)) {
+            repeats = atoi(argv[++n]);
+        }
+        else if (!strcmp(argv[n], "-o") && (n + 1 < argc)) {
+            jsonPath = argv[++n];
+        }
+        else if (!strcmp(argv[n], "-c") && (n + 1 < argc)) {
+            baselinePath = argv[++n];
+        }
+#endif
+        else {
+            fprintf(stderr, "usage: %s [-r repeats] [-o after.json] [-c before.json]\n"
+                    "       %s -k kernel -n calls\n", argv[0], argv[0]);
+            return 1;
+        }
+    }
+    makeInputs();
+
+    // Count mode: one kernel, no timing, for perf or the QEMU instruction plugin
+    if ((only != NULL) || (calls >= 0) || BENCH_TARGET) {
+        int kernel = (only != NULL) ? findKernel(only) : -1;
+
+        if ((kernel < 0) || (calls < 0)) {
+            fprintf(stderr, "count mode needs -k <kernel> and -n <calls>, kernels:");
+            for (n = 0; n < KERNELS; ++n) {
+                fprintf(stderr, " %s", kernels[n].name);
+            }
+            fprintf(stderr, "\n");
+            return 1;
+        }
+        sink += kernels[kernel].run((uint32_t)calls);
+        printf("%s x %ld, checksum %u\n", kernels[kernel].name, calls, (unsigned)sink);
+        return 0;
+    }
+
+#if !BENCH_TARGET
+    if ((repeats < 3) || (repeats > REPEATS_MAX)) {
+        fprintf(stderr, "repeats must be 3..%d\n", REPEATS_MAX);
+        return 1;
+    }
+    if ((baselinePath != NULL) && (readBaseline(baselinePath, baseMedian, baseMad) < 0)) {
+        return 1;
+    }
+
+    printf("%-13s %-13s %10s %10s %8s %9s", "kernel", "per", "ns min", "ns median", "MAD",
+           HAVE_TSC ? "tsc" : "");
+    printf("%s\n", (baselinePath != NULL) ? "     before   change" : "");
+    for (n = 0; n < KERNELS; ++n) {
+        timings[n] = timeKernel(&kernels[n], repeats);
+        printf("%-13s %-13s %10.2f %10.2f %8.2f", kernels[n].name, kernels[n].unit,
+               timings[n].nsMin, timings[n].nsMedian, timings[n].nsMad);
+        if (HAVE_TSC) {
+            printf(" %9.1f", timings[n].tscMedian);
+        }
+        else {
+            printf(" %9s", "");
+        }
+        if ((baselinePath != NULL) && (baseMedian[n] > 0)) {
+            double change = 100.0 * (timings[n].nsMedian - baseMedian[n]) / baseMedian[n];
+
+            // Inside 3 MADs of either run is not a change
+            printf(" %10.2f %+7.1f%%%s", baseMedian[n], change,
+                   (fabs(timings[n].nsMedian - baseMedian[n]) <=
+                    3 * (timings[n].nsMad + baseMad[n])) ? " (noise)" : "");
+        }
+        printf("\n");
+    }
+
+    if (jsonPath != NULL) {
+        if ((json = fopen(jsonPath, "w")) == NULL) {
+            perror(jsonPath);
+            return 1;
+        }
+        writeJson(json, timings, repeats);
+        fclose(json);
+    }
+#endif
+    return 0;
+}
@@ -0,0 +1,168 @@
+/*
+ *************************************************************************************
+ * ECE 4437
+ * TEAM 5: DANK ERRORS
+ *
+ * LINE SENSOR TEST
+ *
+ * Host program, build from the repo root:
+ *  gcc -O2 -I. -o line_sensor_test tools/line_sensor_test.c
+ *
+ * Feeds runs of black and white samples through decodeBarcode() and, for the
+ *  single lines the baseline firmware knew, through classifyLight() too.
+ *  ./line_sensor_test
+ *      checks the finish inside a marker, the bar widths on the thin / thick
+ *          boundary and the marker codes, prints PASS or exits 1 if any check fails
+ *************************************************************************************
+ */
+#include <stdio.h>
+#include <stdint.h>
+#include "robot_profile.h"
+#include "line_sensor.h"
+
+/*
+ *************************************************************************************
+ * DEFINING CONSTANTS
+ *************************************************************************************
+ */
+#define BLACK_COUNT         (2 * LIGHT_BLACK) //decay count of a black sample
+#define WHITE_COUNT         (LIGHT_BLACK / 4) //decay count of a white sample
+#define QUIET               (4 * BARCODE_GAP_MAX) //white samples after a pattern
+#define EVENTS_MAX          8
+
+static const char *lineNames[] = { "NONE", "THIN", "THICK", "CODE" };
+static int failures = 0;
+
+typedef struct {
+    int line[EVENTS_MAX];   //LINE_* in the order they were read
+    uint32_t code;          //state->code of the last LINE_CODE
+    int count;
+} Events;
+
+static void addEvent(Events *events, int line) {
+    if ((line != LINE_NONE) && (events->count < EVENTS_MAX)) {
+        events->line[events->count++] = line;
+    }
+}
+
+    /*
+     *********************************************************************************
+     *  runs[] alternates black and white run lengths [samples], starting with
+     *      black and ending at a 0. QUIET white samples follow, so a marker
+     *          still open at the end gets read.
+     *********************************************************************************
+     */
+static void decodeRuns(const int runs[], Events *barcode, Events *classify) {
+    BarcodeState state;
+    int blackCount = 0;
+    int n, sample, line;
+    uint32_t count;
+
+    resetBarcode(&state);
+    barcode->count = 0;
+    barcode->code = 0;
+    classify->count = 0;
+    for (n = 0; ; ++n) {
+        int length = (runs[n] != 0) ? runs[n] : QUIET;
+
+        count = ((n % 2 == 0) && (runs[n] != 0)) ? BLACK_COUNT : WHITE_COUNT;
+        for (sample = 0; sample < length; ++sample) {
+            line = decodeBarcode(&state, count, LIGHT_BLACK);
+            if (line == LINE_CODE) {
+                barcode->code = state.code;
+            }
+            addEvent(barcode, line);
+            addEvent(classify, classifyLight(&blackCount, count));
+        }
+        if (runs[n] == 0) {
+            return;
+        }
+    }
+}
+
+static void checkEvents(const char *name, const Events *got, const int expected[],
+                        int expectedCount) {
+    int n;
+
+    if (got->count != expectedCount) {
+        fprintf(stderr, "FAIL: %s: %d lines, expected %d\n", name, got->count,
+                expectedCount);
+        ++failures;
+        return;
+    }
+    for (n = 0; n < expectedCount; ++n) {
+        if (got->line[n] != expected[n]) {
+            fprintf(stderr, "FAIL: %s: line %d is %s, expected %s\n", name, n,
+                    lineNames[got->line[n]], lineNames[expected[n]]);
+            ++failures;
+        }
+    }
+}
+
+/*
+ *************************************************************************************
+ * CASES
+ *************************************************************************************
+ */
+    /*
+     *  Single lines: decodeBarcode() must read what classifyLight() read, a thin
+     *      line only later.
+     */
+static void baselineCase(const char *name, const int runs[], const int expected[],
+                         int expectedCount) {
+    Events barcode, classify;
+
+    decodeRuns(runs, &barcode, &classify);
+    printf("%-34s %d lines\n", name, barcode.count);
+    checkEvents(name, &classify, expected, expectedCount);
+    checkEvents(name, &barcode, expected, expectedCount);
+}
+
+static void markerCase(const char *name, const int runs[], const int expected[],
+                       int expectedCount, uint32_t code) {
+    Events barcode, classify;
+
+    decodeRuns(runs, &barcode, &classify);
+    printf("%-34s %d lines, code %u\n", name, barcode.count, barcode.code);
+    checkEvents(name, &barcode, expected, expectedCount);
+    if (barcode.code != code) {
+        fprintf(stderr, "FAIL: %s: code %u, expected %u\n", name, barcode.code, code);
+        ++failures;
+    }
+}
+
+int main(void) {
+    static const int thin[] = { 3, 0 };
+    static const int thick[] = { THICK_LINE_MIN + 5, 0 };
+    static const int onBoundary[] = { THIN_LINE_MAX, 0 };
+    static const int boundaryThenBar[] = { THIN_LINE_MAX, QUIET, 3, 0 };
+    static const int noiseThenBar[] = { THIN_LINE_MIN, QUIET, THIN_LINE_MAX - 1, 0 };
+    static const int thinThenFinish[] = { 3, 2, THICK_LINE_MIN + 2, 0 };
+    static const int markerThenFinish[] = { 3, 2, 3, 2, THICK_LINE_MIN + 2, 0 };
+    static const int code5[] = { 3, 2, 3, 2, 6, 0 };
+    static const int code3[] = { 4, 3, THICK_LINE_MIN, 0 };
+    static const int lineThin[] = { LINE_THIN };
+    static const int lineThick[] = { LINE_THICK };
+    static const int lineCode[] = { LINE_CODE };
+
+    baselineCase("thin line", thin, lineThin, 1);
+    baselineCase("thick line", thick, lineThick, 1);
+    // Neither thin nor thick: both keep counting into the next bar
+    baselineCase("bar of THIN_LINE_MAX samples", onBoundary, lineThin, 0);
+    baselineCase("THIN_LINE_MAX bar, then a thin one", boundaryThenBar, lineThick, 1);
+    baselineCase("noise, then a thin bar", noiseThenBar, lineThick, 0);
+
+    // The finish right behind a start bar or a marker is still the finish
+    markerCase("thin bar, then the finish", thinThenFinish, lineThick, 1, 0);
+    markerCase("marker, then the finish", markerThenFinish, lineThick, 1, 0);
+
+    markerCase("narrow, narrow, wide", code5, lineCode, 1, 5);
+    markerCase("narrow, wide at THICK_LINE_MIN", code3, lineCode, 1, 3);
+
+    if (failures > 0) {
+        fprintf(stderr, "%d checks failed\n", failures);
+        return 1;
+    }
+    printf("PASS\n");
+    return 0;
+}
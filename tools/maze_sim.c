@@ -0,0 +1,1030 @@
+/*
+ *************************************************************************************
+ * ECE 4437
+ * TEAM 5: DANK ERRORS
+ *
+ * MAZE SIMULATOR
+ *
+ * Host program, build from the repo root:
+ *  gcc -O2 -I. -o maze_sim tools/maze_sim.c -lm -lpthread
+ *
+ * Drives a simulated robot through a grid maze with the firmware's own PID, branch
+ *  choice, duties, speed planner and line detection (wall_control.h, line_sensor.h,
+ *  robot_profile.h):
+ *  ./maze_sim [-m maze.txt] [-s name=value ...] [-t trace.csv]
+ *      -m  maze file, '#' = wall, '>' '<' '^' 'v' = start and heading,
+ *          'F' = finish (thick line), anything else = floor
+ *      -s  override a SpeedConfig field to tune the planner, e.g.
+ *          -s maxPercent=130 -s clearMm=450 -s kdFast=0.6
+ *      -t  write time, x, y, heading, branch, speed [%] per control tick
+ *      -S  one run with the noise of this Monte Carlo seed instead of the ideal
+ *          robot, to replay a failure with -t
+ *      -q  wheel encoders and the inner speed loop of USE_QEI (wheel_control.h),
+ *          the encoders count the wheel travel before slip
+ *      -v  battery duty compensation of USE_BATTERY_COMP (battery.h), open loop
+ *          only like the firmware, no effect with -q
+ *      -L  left sensor and corridor centering of USE_LEFT_SENSOR, mirrored from
+ *          the right sensor
+ *      -l  light threshold calibration of USE_LIGHT_CAL (line_sensor.h), try it
+ *          with -n lightBias=-0.5 (a faster measurement loop)
+ *
+ * Monte Carlo, the same seeds for every candidate:
+ *  ./maze_sim -r 2000 [-j threads] [-n name=value ...] [-c name=value,name=value ...]
+ *      -r  runs per candidate, each with its own noise seed
+ *      -j  worker threads (default 4)
+ *      -n  override a NoiseConfig field, e.g. -n irSigma=0.05 -n latencyMs=0
+ *      -c  candidate, -s settings plus these overrides, repeat to compare
+ *  Candidates are ranked by their 90th percentile lap, failures count as
+ *      an infinite lap, so a setting that fails 1 run in 10 never beats one
+ *          that finishes 9 in 10. Past that, the lower failure rate wins.
+ *  The profile's own settings (plus -s) run first as the baseline. When the
+ *      baseline does not finish 90% of its runs the noise or the maze is off,
+ *          nothing is ranked and the exit code is 2.
+ *  "seed" is the first failing run of each candidate, for -S.
+ *  With a battery drain each run lands somewhere in a session, the line under
+ *      each candidate splits its laps into the fresh and the drained half.
+ *
+ * Pick the profile at build time like the firmware: -DROBOT_PROFILE=PROFILE_V10
+ *************************************************************************************
+ */
+#include <stdio.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <pthread.h>
+#include "adc_distance_table.h"
+#include "robot_profile.h"
+#include "wall_control.h"
+#include "line_sensor.h"
+#include "wheel_control.h"
+#include "battery.h"
+
+/*
+ *************************************************************************************
+ * DEFINING CONSTANTS
+ *************************************************************************************
+ */
+#define CONTROL_HZ          20      //PID() rate of the firmware (not HIGH_RATE_MODE)
+#define LIGHT_HZ            100     //Light_Timer, 10000 [us]
+#define PHYSICS_HZ          1000
+#define TIMEOUT_S           300
+
+// Robot, MM_PER_SEC_PER_DUTY and WHEEL_BASE_MM come from robot_profile.h
+#ifndef MOTOR_TAU_S
+#define MOTOR_TAU_S         0.05f   //wheel speed lag behind the duty
+#endif
+#ifndef ROBOT_RADIUS_MM
+#define ROBOT_RADIUS_MM     55.0f   //touching a wall closer than this = crash
+#endif
+#ifndef RIGHT_SENSOR_X
+#define RIGHT_SENSOR_X      0.0f    //right sensor, forward of the center [mm]
+#endif
+#define RIGHT_SENSOR_Y      -40.0f  //                left of the center (negative = right)
+#ifndef RIGHT_SENSOR_ANGLE
+#define RIGHT_SENSOR_ANGLE  45.0f   //                clockwise from the heading [deg]
+#endif
+#define LEFT_SENSOR_Y       (-RIGHT_SENSOR_Y) //-L: left sensor, mirror of the right one
+#define FRONT_SENSOR_X      50.0f   //front sensor
+#define FRONT_SENSOR_Y      0.0f
+#define LIGHT_SENSOR_X      30.0f   //light sensor, on the center line
+
+// Light sensor decay counts, either side of LIGHT_BLACK
+#define LIGHT_WHITE_COUNT   800
+#define LIGHT_BLACK_COUNT   3200
+
+// Maze
+#ifndef CELL_MM
+#define CELL_MM             350
+#endif
+#define MAZE_ROWS           64
+#define MAZE_COLS           64
+
+// Starts in a straight along the right wall like the start box. An inward spiral of
+//  right turns: at a left corner (wall ahead, opening on the left) PID() can match
+//  no branch and hold its duties into the wall, about 1 run in 10 per corner with
+//  the default noise, which would drown the differences between candidates.
+//  Check left corners and dead ends with -m.
+static const char *defaultMaze[] = {
+    "#############",
+    "#>..........#",
+    "###########.#",
+    "#.........#.#",
+    "#.#######.#.#",
+    "#.#...F...#.#",
+    "#.#########.#",
+    "#...........#",
+    "#############",
+    NULL
+};
+
+// Monte Carlo
+#define THREADS_DEFAULT     4
+#define THREADS_MAX         64
+#define CANDIDATES_MAX      16
+#define RANK_PERCENTILE     90
+
+static int encoderLoop = USE_QEI;   //-q
+static int batteryComp = USE_BATTERY_COMP; //-v
+static int leftSensor = USE_LEFT_SENSOR; //-L
+static int lightCal = USE_LIGHT_CAL; //-l
+
+/*
+ *************************************************************************************
+ * NOISE MODELS
+ *************************************************************************************
+ */
+    /*
+     *********************************************************************************
+     *  All zero = the ideal robot. Defaults are first estimates, calibrate them
+     *      on the robot:
+     *  irSigma, adcSigma   park 8 cm from a wall and stream RIGHT, adcSigma = stdev
+     *                          of the codes, irSigma = spread between sensors at
+     *                              the same distance / distance
+     *  latencyMs           ADC trigger to PWM update, from the rate group stats
+     *  motorMismatch       same duty on both wheels, drift over 1 m
+     *  slip                distance logged vs tape measure on the course floor
+     *  lightSigma          LIGHT channel over white, stdev / mean
+     *  lightRunSigma       LIGHT mean between runs (room light, battery)
+     *  lightBias           LIGHT mean of every run vs the profile's counts, for a
+     *                          changed measurement loop, clock or sensor height
+ *  batteryDrain        pack voltage at the end of a session / BATTERY_REFERENCE_MV,
+ *                          each run starts anywhere from fresh to that
+ *  batterySag          pack voltage lost with both motors at DUTY_MAX (internal
+ *                          resistance), log BATTERY while driving and parked
+     *********************************************************************************
+     */
+typedef struct {
+    float irSigma;          //distance gain error, per run and per sample [fraction]
+    float adcSigma;         //ADC noise [codes]
+    int adcBits;            //effective ADC resolution, 12 = ideal quantization
+    float latencyMs;        //sensor sample to new duty, uniform 0..latencyMs per tick
+    float motorMismatch;    //wheel gain error per run, stdev [fraction]
+    float slip;             //wheel speed lost per control tick, uniform 0..slip [fraction]
+    float lightSigma;       //decay count noise per sample [fraction]
+    float lightRunSigma;    //decay count offset per run [fraction]
+    float lightBias;        //decay counts x (1 + this) in every run
+    float batteryDrain;     //pack voltage lost over a session [fraction]
+    float batterySag;       //pack voltage lost at full load [fraction]
+} NoiseConfig;
+
+#define NOISE_CONFIG        { 0.01f, 10.0f, 12, 2.0f, 0.01f, 0.02f, 0.10f, 0.10f, 0.0f, \
+                              0.15f, 0.03f }
+
+// xorshift64*, one per run so results do not depend on the thread count
+typedef struct {
+    uint64_t state;
+} Rng;
+
+static void seedRng(Rng *rng, uint64_t seed) {
+    // splitmix64 so neighbouring seeds start far apart
+    seed += 0x9E3779B97F4A7C15ull;
+    seed = (seed ^ (seed >> 30)) * 0xBF58476D1CE4E5B9ull;
+    seed = (seed ^ (seed >> 27)) * 0x94D049BB133111EBull;
+    rng->state = (seed ^ (seed >> 31)) | 1;
+}
+
+// [0, 1)
+static float uniform(Rng *rng) {
+    rng->state ^= rng->state >> 12;
+    rng->state ^= rng->state << 25;
+    rng->state ^= rng->state >> 27;
+    return ((rng->state * 0x2545F4914F6CDD1Dull) >> 40) / 16777216.0f;
+}
+
+// Box-Muller, mean 0, stdev 1
+static float gaussian(Rng *rng) {
+    float u = uniform(rng);
+
+    return sqrtf(-2.0f * logf(u + 1e-7f)) * cosf(2.0f * (float)M_PI * uniform(rng));
+}
+
+/*
+ *************************************************************************************
+ * MAZE
+ *************************************************************************************
+ */
+typedef struct {
+    char cells[MAZE_ROWS][MAZE_COLS + 1];
+    int rows;
+    int cols;
+    float startX, startY, startHeading;
+} Maze;
+
+static int loadMaze(Maze *maze, const char **lines, FILE *file) {
+    char line[MAZE_COLS + 2];
+    const char *row;
+    int r, c;
+
+    memset(maze, 0, sizeof(Maze));
+    for (r = 0; r < MAZE_ROWS; ++r) {
+        if (file != NULL) {
+            if (fgets(line, sizeof(line), file) == NULL) {
+                break;
+            }
+            line[strcspn(line, "\r\n")] = 0;
+            row = line;
+        }
+        else if ((row = lines[r]) == NULL) {
+            break;
+        }
+        snprintf(maze->cells[r], sizeof(maze->cells[r]), "%.*s", MAZE_COLS, row);
+        if ((int)strlen(maze->cells[r]) > maze->cols) {
+            maze->cols = (int)strlen(maze->cells[r]);
+        }
+        for (c = 0; row[c] != 0; ++c) {
+            const char *heading = strchr("><v^", row[c]);
+
+            if (heading != NULL) {
+                // y grows downward with the rows, heading 0 = +x, clockwise positive
+                static const float angles[] = { 0.0f, (float)M_PI, (float)M_PI / 2, -(float)M_PI / 2 };
+
+                maze->startX = (c + 0.5f) * CELL_MM;
+                maze->startY = (r + 0.5f) * CELL_MM;
+                maze->startHeading = angles[heading - "><v^"];
+            }
+        }
+    }
+    maze->rows = r;
+    return (maze->startX > 0) ? 0 : -1;
+}
+
+static char cellAt(const Maze *maze, float x, float y) {
+    int c = (int)floorf(x / CELL_MM);
+    int r = (int)floorf(y / CELL_MM);
+
+    if ((r < 0) || (c < 0) || (r >= maze->rows) || (c >= maze->cols) ||
+        (maze->cells[r][c] == 0)) {
+        return '#';
+    }
+    return maze->cells[r][c];
+}
+
+    /*
+     *********************************************************************************
+     * Distance from (x, y) along angle to the first wall cell (grid DDA),
+     *  capped at ADC_TABLE_MAX_MM like the sensor.
+     *********************************************************************************
+     */
+static float castRay(const Maze *maze, float x, float y, float angle) {
+    float dx = cosf(angle), dy = sinf(angle);
+    int c = (int)floorf(x / CELL_MM), r = (int)floorf(y / CELL_MM);
+    int stepC = (dx > 0) ? 1 : -1, stepR = (dy > 0) ? 1 : -1;
+    float nextX = (dx > 0) ? (c + 1) * CELL_MM : c * CELL_MM;
+    float nextY = (dy > 0) ? (r + 1) * CELL_MM : r * CELL_MM;
+    float tX = (fabsf(dx) > 1e-6f) ? (nextX - x) / dx : 1e9f;
+    float tY = (fabsf(dy) > 1e-6f) ? (nextY - y) / dy : 1e9f;
+    float dtX = (fabsf(dx) > 1e-6f) ? CELL_MM / fabsf(dx) : 1e9f;
+    float dtY = (fabsf(dy) > 1e-6f) ? CELL_MM / fabsf(dy) : 1e9f;
+    float t = 0.0f;
+
+    while (t < ADC_TABLE_MAX_MM) {
+        if (tX < tY) {
+            t = tX;
+            tX += dtX;
+            c += stepC;
+        }
+        else {
+            t = tY;
+            tY += dtY;
+            r += stepR;
+        }
+        if (cellAt(maze, (c + 0.5f) * CELL_MM, (r + 0.5f) * CELL_MM) == '#') {
+            return (t < ADC_TABLE_MAX_MM) ? t : ADC_TABLE_MAX_MM;
+        }
+    }
+    return ADC_TABLE_MAX_MM;
+}
+
+/*
+ *************************************************************************************
+ * ROBOT
+ *************************************************************************************
+ */
+typedef struct {
+    float x, y, heading;            //[mm], [rad], clockwise positive (y down)
+    float speedLeft, speedRight;    //wheel speeds [mm/s]
+    int commandLeft, commandRight;  //duties [1/DUTY_ONE %], negative = reverse
+    int requestLeft, requestRight;  //duties PID() commanded, held when no branch matches
+    int pendingLeft, pendingRight;  //duties waiting out the latency
+    int pendingStep;                //physics step they take effect, -1 = none
+    int stopTicks;                  //stopBeforeReverse() state
+    float targetLeft, targetRight;  //-q: wheel speeds PID() asked for [mm/s]
+    float wheelLeft, wheelRight;    //-q: wheel travel [mm], what the encoders see
+    WheelState wheels[2];
+    int branch;
+    int wallMode;                   //-L: corridorMode() state
+    int lastError;
+    SpeedState speed;
+
+    // Noise drawn once per run
+    float irGainRight, irGainFront, irGainLeft;
+    float motorGainLeft, motorGainRight;
+    float lightGain;
+    float slipLeft, slipRight;      //this control tick
+
+    BarcodeState barcode;           //lightSensorCalculation() state
+    LightCalibration light;         //-l: learned threshold, LIGHT_BLACK otherwise
+
+    float packMv;                   //no-load pack voltage this run [mV]
+    float batteryMv;                //under the present load [mV]
+    BatteryState battery;           //-v: batteryGroup() state
+} Robot;
+
+#define RESULT_FINISHED     0
+#define RESULT_CRASHED      1
+#define RESULT_TIMEOUT      2
+#define RESULT_FALSE_FINISH 3       //stopped on a thick line away from the finish
+#define RESULTS             4
+
+typedef struct {
+    int outcome;                    //RESULT_*
+    float lapTime;                  //[s], only for RESULT_FINISHED
+    float meanError;                //mean |right - target| [ADC code]
+    float topSpeed;                 //[% of the profile duties]
+    float drained;                  //where in the session the run was, 0 = fresh pack
+    unsigned centeredTicks;         //-L: control ticks in WALL_CENTER
+    unsigned branchTicks[BRANCHES];
+} SimResult;
+
+static int touchesWall(const Maze *maze, const Robot *robot) {
+    int n;
+
+    for (n = 0; n < 8; ++n) {
+        float angle = n * (float)M_PI / 4;
+
+        if (cellAt(maze, robot->x + ROBOT_RADIUS_MM * cosf(angle),
+                   robot->y + ROBOT_RADIUS_MM * sinf(angle)) == '#') {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+static float sensorRay(const Maze *maze, const Robot *robot,
+                       float ahead, float side, float angle) {
+    float c = cosf(robot->heading), s = sinf(robot->heading);
+    // side is to the left, left of the heading is -90 degrees with y down
+    float x = robot->x + ahead * c + side * s;
+    float y = robot->y + ahead * s - side * c;
+
+    return castRay(maze, x, y, robot->heading + angle);
+}
+
+    /*
+     *********************************************************************************
+     * [mm] -> ADC code through the same curve as adc_distance_table.h, with the
+     *  sensor's gain error, ADC noise and the effective resolution on top.
+     *********************************************************************************
+     */
+static int readIr(const NoiseConfig *noise, Rng *rng, float mm, float gain) {
+    int quantum = 1 << (12 - noise->adcBits);
+    float code;
+
+    mm *= gain * (1.0f + noise->irSigma * gaussian(rng));
+    if (mm < 0.0f) {
+        mm = 0.0f;
+    }
+    if (mm > ADC_TABLE_MAX_MM) {
+        mm = ADC_TABLE_MAX_MM;
+    }
+    code = MM_TO_ADC((int)(mm + 0.5f)) + noise->adcSigma * gaussian(rng);
+    if (code < 0.0f) {
+        code = 0.0f;
+    }
+    if (code > 4095.0f) {
+        code = 4095.0f;
+    }
+    return ((int)code / quantum) * quantum;
+}
+
+    /*
+     *********************************************************************************
+     * One control tick, the same steps as PID() in the firmware. The new duties
+     *  reach the wheels after the latency.
+     *********************************************************************************
+     */
+static void controlTick(const Maze *maze, const SpeedConfig *config, const NoiseConfig *noise,
+                        Rng *rng, Robot *robot, SimResult *result, int step) {
+    int rightValue = readIr(noise, rng, sensorRay(maze, robot, RIGHT_SENSOR_X, RIGHT_SENSOR_Y,
+                                                  RIGHT_SENSOR_ANGLE * (float)M_PI / 180),
+                            robot->irGainRight);
+    int frontValue = readIr(noise, rng, sensorRay(maze, robot, FRONT_SENSOR_X, FRONT_SENSOR_Y,
+                                                  0.0f),
+                            robot->irGainFront);
+    int error;
+    int left = robot->requestLeft, right = robot->requestRight;
+    float percent, kp, kd, pid;
+
+    if (leftSensor) {
+        int leftValue = readIr(noise, rng, sensorRay(maze, robot, RIGHT_SENSOR_X, LEFT_SENSOR_Y,
+                                                     -RIGHT_SENSOR_ANGLE * (float)M_PI / 180),
+                               robot->irGainLeft);
+
+        robot->wallMode = corridorMode(robot->wallMode, leftValue, rightValue);
+        if (robot->wallMode == WALL_CENTER) {
+            rightValue = centeredRightValue(leftValue, rightValue);
+            ++result->centeredTicks;
+        }
+    }
+    error = rightValue - TARGET_VALUE;
+    percent = planSpeed(config, &robot->speed, adcToMM[frontValue], error, robot->branch,
+                        1.0f / CONTROL_HZ);
+    scheduleGains(config, percent, &kp, &kd);
+    pid = wallPid(error, robot->lastError, kp, kd, 1.0f / CONTROL_HZ);
+    robot->lastError = error;
+    robot->branch = selectBranch(pid, frontValue);
+    branchDuties(robot->branch, percent, &left, &right);
+    // A brake is duty 0 here, the motor lag already models the shorted winding
+    if (stopBeforeReverse(left, right, robot->requestLeft, robot->requestRight,
+                          (REVERSE_BRAKE_MS * CONTROL_HZ + 999) / 1000,
+                          &robot->stopTicks) == MOTOR_BRAKE) {
+        robot->pendingLeft = 0;
+        robot->pendingRight = 0;
+    }
+    else {
+        robot->pendingLeft = left;
+        robot->pendingRight = right;
+    }
+    robot->requestLeft = left;
+    robot->requestRight = right;
+    robot->pendingStep = step + (int)(uniform(rng) * noise->latencyMs * PHYSICS_HZ / 1000);
+    robot->slipLeft = uniform(rng) * noise->slip;
+    robot->slipRight = uniform(rng) * noise->slip;
+
+    result->meanError += abs(error);
+    if (percent > result->topSpeed) {
+        result->topSpeed = percent;
+    }
+    ++result->branchTicks[robot->branch];
+}
+
+    /*
+     *********************************************************************************
+     * One light sample through decodeBarcode(), like lightSensorCalculation().
+     *  Returns 1 when the robot would stop on a thick line.
+     *********************************************************************************
+     */
+static int lightTick(const Maze *maze, const NoiseConfig *noise, Rng *rng, Robot *robot) {
+    float x = robot->x + LIGHT_SENSOR_X * cosf(robot->heading);
+    float y = robot->y + LIGHT_SENSOR_X * sinf(robot->heading);
+    float count = (cellAt(maze, x, y) == 'F') ? LIGHT_BLACK_COUNT : LIGHT_WHITE_COUNT;
+
+    count *= (1.0f + noise->lightBias) * robot->lightGain *
+             (1.0f + noise->lightSigma * gaussian(rng));
+    if (count < 0.0f) {
+        count = 0.0f;
+    }
+    if (lightCal) {
+        updateLightCalibration(&robot->light, (uint32_t)count);
+    }
+    // Thin lines and markers only start and stop telemetry or change zones
+    return decodeBarcode(&robot->barcode, (uint32_t)count, robot->light.threshold) ==
+           LINE_THICK;
+}
+
+    /*
+     *********************************************************************************
+     * -q: one pass of wheelISR(). The encoders truncate the wheel travel to whole
+     *  counts, the inner loop sets the duties.
+     *********************************************************************************
+     */
+static void wheelTick(Robot *robot) {
+    static const WheelConfig config = WHEEL_CONFIG;
+    const float dt = 1.0f / WHEEL_LOOP_HZ;
+
+    updateWheelSpeed(&config, &robot->wheels[0],
+                     (int32_t)floorf(robot->wheelLeft / WHEEL_MM_PER_COUNT), dt);
+    updateWheelSpeed(&config, &robot->wheels[1],
+                     (int32_t)floorf(robot->wheelRight / WHEEL_MM_PER_COUNT), dt);
+    robot->commandLeft = (int)roundf(wheelDuty(&config, &robot->wheels[0],
+                                               robot->targetLeft, dt) * DUTY_ONE);
+    robot->commandRight = (int)roundf(wheelDuty(&config, &robot->wheels[1],
+                                                robot->targetRight, dt) * DUTY_ONE);
+}
+
+    /*
+     *********************************************************************************
+     *  The motors see duty x pack voltage: MM_PER_SEC_PER_DUTY holds at
+     *      BATTERY_REFERENCE_MV, a drained or sagging pack drives slower.
+     *      -v scales the duties like driveMotors() with USE_BATTERY_COMP, not the
+     *          -q loop's, which already holds the wheel speeds.
+     *********************************************************************************
+     */
+static void physicsStep(const NoiseConfig *noise, Robot *robot, float dt) {
+    float alpha = dt / (MOTOR_TAU_S + dt);
+    float speed, turnRate, left, right, volts;
+    int dutyLeft = robot->commandLeft, dutyRight = robot->commandRight;
+
+    if (batteryComp && !encoderLoop) {
+        dutyLeft = compensateDuty(&robot->battery, dutyLeft);
+        dutyRight = compensateDuty(&robot->battery, dutyRight);
+    }
+    robot->batteryMv = robot->packMv - noise->batterySag * BATTERY_REFERENCE_MV *
+                       (abs(dutyLeft) + abs(dutyRight)) / (2.0f * DUTY_MAX);
+    volts = robot->batteryMv / BATTERY_REFERENCE_MV;
+
+    robot->speedLeft += alpha * (dutyLeft * volts * MM_PER_SEC_PER_DUTY / DUTY_ONE *
+                                 robot->motorGainLeft - robot->speedLeft);
+    robot->speedRight += alpha * (dutyRight * volts * MM_PER_SEC_PER_DUTY / DUTY_ONE *
+                                  robot->motorGainRight - robot->speedRight);
+    robot->wheelLeft += robot->speedLeft * dt;
+    robot->wheelRight += robot->speedRight * dt;
+    left = robot->speedLeft * (1.0f - robot->slipLeft);
+    right = robot->speedRight * (1.0f - robot->slipRight);
+    speed = (left + right) / 2;
+    turnRate = (left - right) / WHEEL_BASE_MM; //left faster = right turn
+    robot->heading += turnRate * dt;
+    robot->x += speed * cosf(robot->heading) * dt;
+    robot->y += speed * sinf(robot->heading) * dt;
+}
+
+// Within half a cell of a finish cell, the robot stops just after the line
+static int nearFinish(const Maze *maze, const Robot *robot) {
+    return (cellAt(maze, robot->x, robot->y) == 'F') ||
+           (cellAt(maze, robot->x - CELL_MM / 2 * cosf(robot->heading),
+                   robot->y - CELL_MM / 2 * sinf(robot->heading)) == 'F');
+}
+
+static SimResult simulate(const Maze *maze, const SpeedConfig *config, const NoiseConfig *noise,
+                          uint64_t seed, FILE *trace) {
+    SimResult result;
+    Robot robot;
+    Rng rng;
+    int step, ticks = 0;
+
+    memset(&result, 0, sizeof(result));
+    memset(&robot, 0, sizeof(robot));
+    seedRng(&rng, seed);
+    robot.x = maze->startX;
+    robot.y = maze->startY;
+    robot.heading = maze->startHeading;
+    robot.commandLeft = PWM_ADJUST * DUTY_ONE;
+    robot.commandRight = PWM_ADJUST * DUTY_ONE;
+    robot.requestLeft = robot.commandLeft;
+    robot.requestRight = robot.commandRight;
+    robot.pendingLeft = robot.commandLeft;
+    robot.pendingRight = robot.commandRight;
+    robot.targetLeft = robot.commandLeft * MM_PER_SEC_PER_DUTY / DUTY_ONE;
+    robot.targetRight = robot.commandRight * MM_PER_SEC_PER_DUTY / DUTY_ONE;
+    robot.pendingStep = -1;
+    robot.speed.percent = 100.0f;
+    robot.irGainRight = 1.0f + noise->irSigma * gaussian(&rng);
+    robot.irGainFront = 1.0f + noise->irSigma * gaussian(&rng);
+    robot.motorGainLeft = 1.0f + noise->motorMismatch * gaussian(&rng);
+    robot.motorGainRight = 1.0f + noise->motorMismatch * gaussian(&rng);
+    robot.lightGain = 1.0f + noise->lightRunSigma * gaussian(&rng);
+    resetLightCalibration(&robot.light);
+    result.drained = uniform(&rng);
+    if (leftSensor) {
+        robot.irGainLeft = 1.0f + noise->irSigma * gaussian(&rng);
+    }
+    robot.packMv = BATTERY_REFERENCE_MV * (1.0f - noise->batteryDrain * result.drained);
+    robot.batteryMv = robot.packMv;
+    resetBattery(&robot.battery);
+    result.outcome = RESULT_TIMEOUT;
+
+    for (step = 0; step < TIMEOUT_S * PHYSICS_HZ; ++step) {
+        if ((step % (PHYSICS_HZ / CONTROL_HZ)) == 0) {
+            controlTick(maze, config, noise, &rng, &robot, &result, step);
+            ++ticks;
+            if (trace != NULL) {
+                fprintf(trace, "%.3f,%.1f,%.1f,%.3f,%d,%.1f\n", (float)step / PHYSICS_HZ,
+                        robot.x, robot.y, robot.heading, robot.branch, robot.speed.percent);
+            }
+        }
+        if ((robot.pendingStep >= 0) && (step >= robot.pendingStep)) {
+            if (encoderLoop) {
+                robot.targetLeft = robot.pendingLeft * MM_PER_SEC_PER_DUTY / DUTY_ONE;
+                robot.targetRight = robot.pendingRight * MM_PER_SEC_PER_DUTY / DUTY_ONE;
+            }
+            else {
+                robot.commandLeft = robot.pendingLeft;
+                robot.commandRight = robot.pendingRight;
+            }
+            robot.pendingStep = -1;
+        }
+        if (encoderLoop && ((step % (PHYSICS_HZ / WHEEL_LOOP_HZ)) == 0)) {
+            wheelTick(&robot);
+        }
+        if (batteryComp && ((step % (PHYSICS_HZ / BATTERY_RATE_HZ)) == 0)) {
+            // The divider tap through the ADC, same noise as the IR channels
+            float code = robot.batteryMv / BATTERY_DIVIDER * 4095 / BATTERY_ADC_MV +
+                         noise->adcSigma * gaussian(&rng);
+
+            updateBattery(&robot.battery, batteryCodeToMv((code > 0) ? (uint32_t)code : 0));
+        }
+        physicsStep(noise, &robot, 1.0f / PHYSICS_HZ);
+        if (touchesWall(maze, &robot)) {
+            result.outcome = RESULT_CRASHED;
+            break;
+        }
+        if (((step % (PHYSICS_HZ / LIGHT_HZ)) == 0) && lightTick(maze, noise, &rng, &robot)) {
+            result.outcome = nearFinish(maze, &robot) ? RESULT_FINISHED : RESULT_FALSE_FINISH;
+            result.lapTime = (float)step / PHYSICS_HZ;
+            break;
+        }
+    }
+    if (ticks > 0) {
+        result.meanError /= ticks;
+    }
+    return result;
+}
+
+/*
+ *************************************************************************************
+ * TUNING OVERRIDES
+ *************************************************************************************
+ */
+typedef struct {
+    const char *name;
+    size_t offset;
+    int isInt;
+} Field;
+
+static const Field speedFields[] = {
+    { "kp",         offsetof(SpeedConfig, kp),         0 },
+    { "kd",         offsetof(SpeedConfig, kd),         0 },
+    { "kpFast",     offsetof(SpeedConfig, kpFast),     0 },
+    { "kdFast",     offsetof(SpeedConfig, kdFast),     0 },
+    { "maxPercent", offsetof(SpeedConfig, maxPercent), 0 },
+    { "minPercent", offsetof(SpeedConfig, minPercent), 0 },
+    { "clearMm",    offsetof(SpeedConfig, clearMm),    1 },
+    { "brakeMm",    offsetof(SpeedConfig, brakeMm),    1 },
+    { "slowMm",     offsetof(SpeedConfig, slowMm),     1 },
+    { "steadyBand", offsetof(SpeedConfig, steadyBand), 1 },
+    { "rampUp",     offsetof(SpeedConfig, rampUp),     0 },
+    { NULL, 0, 0 }
+};
+
+static const Field noiseFields[] = {
+    { "irSigma",       offsetof(NoiseConfig, irSigma),       0 },
+    { "adcSigma",      offsetof(NoiseConfig, adcSigma),      0 },
+    { "adcBits",       offsetof(NoiseConfig, adcBits),       1 },
+    { "latencyMs",     offsetof(NoiseConfig, latencyMs),     0 },
+    { "motorMismatch", offsetof(NoiseConfig, motorMismatch), 0 },
+    { "slip",          offsetof(NoiseConfig, slip),          0 },
+    { "lightSigma",    offsetof(NoiseConfig, lightSigma),    0 },
+    { "lightRunSigma", offsetof(NoiseConfig, lightRunSigma), 0 },
+    { "lightBias",     offsetof(NoiseConfig, lightBias),     0 },
+    { "batteryDrain",  offsetof(NoiseConfig, batteryDrain),  0 },
+    { "batterySag",    offsetof(NoiseConfig, batterySag),    0 },
+    { NULL, 0, 0 }
+};
+
+    /*
+     *********************************************************************************
+     * Applies "name=value[,name=value ...]" to the struct at base.
+     *  Returns -1 on an unknown name.
+     *********************************************************************************
+     */
+static int setFields(void *base, const Field *fields, const char *assignments) {
+    const char *name = assignments;
+
+    while (*name != 0) {
+        const char *equals = strchr(name, '=');
+        size_t length = strcspn(name, ",");
+        const Field *field;
+
+        if ((equals == NULL) || ((size_t)(equals - name) > length)) {
+            return -1;
+        }
+        for (field = fields; field->name != NULL; ++field) {
+            if ((strlen(field->name) == (size_t)(equals - name)) &&
+                !strncmp(name, field->name, equals - name)) {
+                break;
+            }
+        }
+        if (field->name == NULL) {
+            return -1;
+        }
+        if (field->isInt) {
+            *(int *)((char *)base + field->offset) = atoi(equals + 1);
+        }
+        else {
+            *(float *)((char *)base + field->offset) = (float)atof(equals + 1);
+        }
+        name += length;
+        if (*name == ',') {
+            ++name;
+        }
+    }
+    return 0;
+}
+
+/*
+ *************************************************************************************
+ * MONTE CARLO
+ *************************************************************************************
+ */
+typedef struct {
+    const char *label;
+    SpeedConfig config;
+    SimResult *results;             //one per seed
+} Candidate;
+
+typedef struct {
+    const Maze *maze;
+    const NoiseConfig *noise;
+    Candidate *candidates;
+    int candidateCount;
+    int runs;
+    int thread;
+    int threads;
+} Worker;
+
+// Worker n takes runs n, n + threads, ..., seed = run, so any thread count agrees
+static void *runWorker(void *argument) {
+    Worker *worker = argument;
+    int candidate, run;
+
+    for (candidate = 0; candidate < worker->candidateCount; ++candidate) {
+        for (run = worker->thread; run < worker->runs; run += worker->threads) {
+            worker->candidates[candidate].results[run] =
+                simulate(worker->maze, &worker->candidates[candidate].config,
+                         worker->noise, (uint64_t)run, NULL);
+        }
+    }
+    return NULL;
+}
+
+static int compareFloat(const void *a, const void *b) {
+    float x = *(const float *)a, y = *(const float *)b;
+
+    return (x > y) - (x < y);
+}
+
+    /*
+     *********************************************************************************
+     *  Prints one table row. laps = scratch, sorted with failures as INFINITY.
+     *      Returns the RANK_PERCENTILE lap, or a large offset times 1 + the
+     *          failure rate when that lap is a failure (an offset plus the rate
+     *              would be rounded off in a float).
+     *********************************************************************************
+     */
+static float summarize(const Candidate *candidate, int runs, float *laps, int session) {
+    unsigned outcomes[RESULTS] = { 0 };
+    unsigned halfRuns[2] = { 0 }, halfFinished[2] = { 0 };
+    double sum = 0.0, halfSum[2] = { 0.0 };
+    int n, firstFailure = -1;
+
+    for (n = 0; n < runs; ++n) {
+        const SimResult *result = &candidate->results[n];
+        int half = (result->drained >= 0.5f);
+
+        ++outcomes[result->outcome];
+        ++halfRuns[half];
+        if (result->outcome == RESULT_FINISHED) {
+            laps[n] = result->lapTime;
+            sum += result->lapTime;
+            halfSum[half] += result->lapTime;
+            ++halfFinished[half];
+        }
+        else {
+            laps[n] = INFINITY;
+            if (firstFailure < 0) {
+                firstFailure = n;
+            }
+        }
+    }
+    qsort(laps, runs, sizeof(float), compareFloat);
+
+    printf("%-28s %5.1f%% %5u %5u %5u", candidate->label,
+           100.0f * (runs - outcomes[RESULT_FINISHED]) / runs, outcomes[RESULT_CRASHED],
+           outcomes[RESULT_TIMEOUT], outcomes[RESULT_FALSE_FINISH]);
+    if (outcomes[RESULT_FINISHED] > 0) {
+        printf(" %7.2f", sum / outcomes[RESULT_FINISHED]);
+    }
+    else {
+        printf(" %7s", "-");
+    }
+    printf(" %7.2f %7.2f %7.2f %7.2f", laps[0], laps[runs / 2], laps[runs * 90 / 100],
+           laps[runs * 99 / 100]);
+    if (firstFailure >= 0) {
+        printf(" %5d", firstFailure);
+    }
+    printf("\n");
+    if (session) {
+        printf("  session, fresh half:");
+        for (n = 0; n < 2; ++n) {
+            printf(" %.1f%% fail, mean %.2f s%s", (halfRuns[n] > 0) ?
+                   100.0f * (halfRuns[n] - halfFinished[n]) / halfRuns[n] : 0.0f,
+                   (halfFinished[n] > 0) ? halfSum[n] / halfFinished[n] : 0.0,
+                   (n == 0) ? ", drained half:" : "\n");
+        }
+    }
+    if (isinf(laps[runs * RANK_PERCENTILE / 100])) {
+        return 1e6f * (1.0f + (float)(runs - outcomes[RESULT_FINISHED]) / runs);
+    }
+    return laps[runs * RANK_PERCENTILE / 100];
+}
+
+static int monteCarlo(const Maze *maze, const NoiseConfig *noise, Candidate *candidates,
+                      int candidateCount, int runs, int threads) {
+    pthread_t ids[THREADS_MAX];
+    Worker workers[THREADS_MAX];
+    float *laps = malloc(runs * sizeof(float));
+    float rank, bestRank = 0.0f, baseline = 0.0f;
+    int n, best = -1;
+
+    if (laps == NULL) {
+        fprintf(stderr, "out of memory\n");
+        return 1;
+    }
+    for (n = 0; n < candidateCount; ++n) {
+        if ((candidates[n].results = malloc(runs * sizeof(SimResult))) == NULL) {
+            fprintf(stderr, "out of memory\n");
+            return 1;
+        }
+    }
+
+    for (n = 0; n < threads; ++n) {
+        workers[n] = (Worker){ maze, noise, candidates, candidateCount, runs, n, threads };
+        if (pthread_create(&ids[n], NULL, runWorker, &workers[n]) != 0) {
+            fprintf(stderr, "pthread_create failed\n");
+            return 1;
+        }
+    }
+    for (n = 0; n < threads; ++n) {
+        pthread_join(ids[n], NULL);
+    }
+
+    printf("profile %s, %d runs per candidate, %d threads\n", PROFILE_NAME, runs, threads);
+    printf("noise: ir %.3f, adc %.0f codes at %d bits, latency %.1f ms, motors %.3f, "
+           "slip %.3f, light %.2f / %.2f per run\n", noise->irSigma, noise->adcSigma,
+           noise->adcBits, noise->latencyMs, noise->motorMismatch, noise->slip,
+           noise->lightSigma, noise->lightRunSigma);
+    printf("light counts x %.2f, threshold %s\n", 1.0f + noise->lightBias,
+           lightCal ? "calibrated" : "LIGHT_BLACK");
+    printf("battery: drain %.2f over a session, sag %.2f at full load, compensation %s\n",
+           noise->batteryDrain, noise->batterySag, batteryComp ? "on" : "off");
+    printf("%-28s %6s %5s %5s %5s %7s %7s %7s %7s %7s %5s\n", "candidate", "fail", "crash",
+           "time", "false", "mean s", "best", "p50", "p90", "p99", "seed");
+    for (n = 0; n < candidateCount; ++n) {
+        rank = summarize(&candidates[n], runs, laps, noise->batteryDrain > 0);
+        if (n == 0) {
+            baseline = rank;
+        }
+        if ((best < 0) || (rank < bestRank)) {
+            bestRank = rank;
+            best = n;
+        }
+        free(candidates[n].results);
+    }
+    free(laps);
+    // A baseline that crashes this often says more about the model than the candidates
+    if (baseline >= 1e6f) {
+        printf("baseline fails more than 1 run in %d, calibrate the noise (-n) or the "
+               "maze before ranking\n", 100 / (100 - RANK_PERCENTILE));
+        return 2;
+    }
+    if (bestRank < 1e6f) {
+        printf("best by p%d lap: %s (%.2f s)\n", RANK_PERCENTILE, candidates[best].label,
+               bestRank);
+    }
+    else {
+        printf("no candidate finishes %d%% of its runs, fewest failures: %s\n",
+               RANK_PERCENTILE, candidates[best].label);
+    }
+    return 0;
+}
+
+/*
+ *************************************************************************************
+ * MAIN
+ *************************************************************************************
+ */
+int main(int argc, char **argv) {
+    static const char *branchNames[BRANCHES] = {
+        "NONE", "UTURN", "LEFT", "RIGHT", "SHARP", "STRAIGHT", "SPECIAL"
+    };
+    static const char *outcomeNames[RESULTS] = {
+        "FINISHED", "CRASHED", "TIMEOUT", "FALSE FINISH"
+    };
+    static Candidate candidates[CANDIDATES_MAX];
+    const char *candidateSpecs[CANDIDATES_MAX];
+    SpeedConfig config = SPEED_CONFIG;
+    NoiseConfig noise = NOISE_CONFIG;
+    const NoiseConfig ideal = { 0.0f, 0.0f, 12, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f,
+                                0.0f };
+    const char *mazeFile = NULL, *traceFile = NULL;
+    FILE *file = NULL, *trace = NULL;
+    int runs = 0, threads = THREADS_DEFAULT, candidateCount = 1; //[0] = the baseline
+    long seed = -1;
+    SimResult result;
+    Maze maze;
+    int n;
+
+    for (n = 1; n < argc; ++n) {
+        if (!strcmp(argv[n], "-m") && (n + 1 < argc)) {
+            mazeFile = argv[++n];
+        }
+        else if (!strcmp(argv[n], "-t") && (n + 1 < argc)) {
+            traceFile = argv[++n];
+        }
+        else if (!strcmp(argv[n], "-s") && (n + 1 < argc)) {
+            if (setFields(&config, speedFields, argv[++n]) < 0) {
+                fprintf(stderr, "unknown setting %s\n", argv[n]);
+                return 1;
+            }
+        }
+        else if (!strcmp(argv[n], "-n") && (n + 1 < argc)) {
+            if (setFields(&noise, noiseFields, argv[++n]) < 0) {
+                fprintf(stderr, "unknown noise setting %s\n", argv[n]);
+                return 1;
+            }
+        }
+        else if (!strcmp(argv[n], "-c") && (n + 1 < argc) && (candidateCount < CANDIDATES_MAX)) {
+            candidateSpecs[candidateCount++] = argv[++n];
+        }
+        else if (!strcmp(argv[n], "-r") && (n + 1 < argc)) {
+            runs = atoi(argv[++n]);
+        }
+        else if (!strcmp(argv[n], "-S") && (n + 1 < argc)) {
+            seed = atol(argv[++n]);
+        }
+        else if (!strcmp(argv[n], "-j") && (n + 1 < argc)) {
+            threads = atoi(argv[++n]);
+        }
+        else if (!strcmp(argv[n], "-q")) {
+            encoderLoop = 1;
+        }
+        else if (!strcmp(argv[n], "-v")) {
+            batteryComp = 1;
+        }
+        else if (!strcmp(argv[n], "-L")) {
+            leftSensor = 1;
+        }
+        else if (!strcmp(argv[n], "-l")) {
+            lightCal = 1;
+        }
+        else {
+            fprintf(stderr, "usage: %s [-m maze.txt] [-s name=value ...] [-t trace.csv] [-S seed] [-q] [-v] [-L] [-l]\n"
+                    "       [-r runs [-j threads] [-n name=value ...] [-c name=value,... ...]]\n",
+                    argv[0]);
+            return 1;
+        }
+    }
+    if ((noise.adcBits < 1) || (noise.adcBits > 12) || (threads < 1) || (threads > THREADS_MAX)) {
+        fprintf(stderr, "adcBits must be 1..12, threads 1..%d\n", THREADS_MAX);
+        return 1;
+    }
+
+    if ((mazeFile != NULL) && ((file = fopen(mazeFile, "r")) == NULL)) {
+        perror(mazeFile);
+        return 1;
+    }
+    if (loadMaze(&maze, defaultMaze, file) < 0) {
+        fprintf(stderr, "maze has no start ('>' '<' '^' 'v')\n");
+        return 1;
+    }
+    if (file != NULL) {
+        fclose(file);
+    }
+
+    if (runs > 0) {
+        // The baseline: the -s settings alone
+        candidateSpecs[0] = "";
+        for (n = 0; n < candidateCount; ++n) {
+            candidates[n].label = (*candidateSpecs[n] != 0) ? candidateSpecs[n] : "profile";
+            candidates[n].config = config;
+            if (setFields(&candidates[n].config, speedFields, candidateSpecs[n]) < 0) {
+                fprintf(stderr, "unknown setting in %s\n", candidateSpecs[n]);
+                return 1;
+            }
+        }
+        return monteCarlo(&maze, &noise, candidates, candidateCount, runs, threads);
+    }
+
+    // One run of the ideal robot, or of one noisy seed
+    if ((traceFile != NULL) && ((trace = fopen(traceFile, "w")) == NULL)) {
+        perror(traceFile);
+        return 1;
+    }
+    result = (seed >= 0) ? simulate(&maze, &config, &noise, (uint64_t)seed, trace) :
+                           simulate(&maze, &config, &ideal, 0, trace);
+    if (trace != NULL) {
+        fclose(trace);
+    }
+
+    printf("profile %s, speed %d..%d%%\n", PROFILE_NAME,
+           (int)config.minPercent, (int)config.maxPercent);
+    if (result.outcome == RESULT_FINISHED) {
+        printf("lap              %.2f s\n", result.lapTime);
+    }
+    else {
+        printf("lap              %s\n", outcomeNames[result.outcome]);
+    }
+    printf("mean |error|     %.0f ADC codes\n", result.meanError);
+    printf("top speed        %.0f%%\n", result.topSpeed);
+    if (leftSensor) {
+        printf("centered         %u control ticks\n", result.centeredTicks);
+    }
+    printf("branch ticks    ");
+    for (n = 0; n < BRANCHES; ++n) {
+        printf(" %s %u", branchNames[n], result.branchTicks[n]);
+    }
+    printf("\n");
+    return (result.outcome == RESULT_FINISHED) ? 0 : 2;
+}
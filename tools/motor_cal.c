@@ -0,0 +1,206 @@
+/*
+ *************************************************************************************
+ * ECE 4437
+ * TEAM 5: DANK ERRORS
+ *
+ * GENERATES motor_calibration.h
+ *
+ * Host program, build and run from the repo root:
+ *  gcc -O2 -o motor_cal tools/motor_cal.c
+ *  ./motor_cal < speeds.csv > motor_calibration.h
+ *  ./motor_cal < /dev/null > motor_calibration.h     (uncalibrated, both motors equal)
+ *
+ * speeds.csv has one measurement per line, "#" starts a comment:
+ *  L,60,287.5          motor (L or R), duty [%], wheel speed [mm/s]
+ *
+ * Take the speeds with the robot on a stand (tachometer, or wheel turns over a
+ *  timed interval x the wheel circumference), or from timed straight runs with
+ *  one motor's duty held. Include the duties where the wheel does not turn yet,
+ *  with speed 0, they bound the deadband.
+ *************************************************************************************
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+/*
+ *************************************************************************************
+ * DEFINING CONSTANTS
+ *************************************************************************************
+ */
+#define LINE_SIZE           128
+#define POINTS              256     //per motor
+#define MOTORS              2
+#define DUTY_TOP            99      //DUTY_MAX of the firmware [%]
+#define MIN_POINTS          2       //moving points per motor for a fit
+
+static const char motorNames[MOTORS] = { 'L', 'R' };
+
+typedef struct {
+    double duty[POINTS];
+    double speed[POINTS];
+    int count;
+    double stalledDuty;             //highest duty measured with speed 0
+} Samples;
+
+typedef struct {
+    double slope;                   //[mm/s per %] above the deadband
+    double deadband;                //[%]
+    double rms;                     //fit residual [mm/s]
+} Curve;
+
+/*
+ *************************************************************************************
+ * FIT
+ *************************************************************************************
+ */
+    /*
+     *********************************************************************************
+     *  speed = slope * (duty - deadband), least squares over the moving points.
+     *      deadband = -intercept / slope, never below the highest stalled duty.
+     *********************************************************************************
+     */
+static int fitCurve(const Samples *samples, Curve *curve) {
+    double sx = 0, sy = 0, sxx = 0, sxy = 0, n = 0, intercept, sse = 0;
+    int i;
+
+    for (i = 0; i < samples->count; ++i) {
+        if (samples->speed[i] > 0) {
+            sx += samples->duty[i];
+            sy += samples->speed[i];
+            sxx += samples->duty[i] * samples->duty[i];
+            sxy += samples->duty[i] * samples->speed[i];
+            ++n;
+        }
+    }
+    if ((n < MIN_POINTS) || (n * sxx - sx * sx <= 0)) {
+        return 0;
+    }
+    curve->slope = (n * sxy - sx * sy) / (n * sxx - sx * sx);
+    intercept = (sy - curve->slope * sx) / n;
+    if (curve->slope <= 0) {
+        return 0;
+    }
+    curve->deadband = -intercept / curve->slope;
+    if (curve->deadband < samples->stalledDuty) {
+        curve->deadband = samples->stalledDuty;
+    }
+    if (curve->deadband < 0) {
+        curve->deadband = 0;
+    }
+
+    for (i = 0; i < samples->count; ++i) {
+        if (samples->speed[i] > 0) {
+            double error = samples->speed[i] -
+                           curve->slope * (samples->duty[i] - curve->deadband);
+            sse += error * error;
+        }
+    }
+    curve->rms = sqrt(sse / n);
+    return 1;
+}
+
+/*
+ *************************************************************************************
+ * MAIN
+ *************************************************************************************
+ */
+int main(void) {
+    static Samples samples[MOTORS];
+    Curve curves[MOTORS];
+    char line[LINE_SIZE];
+    double reference;
+    int lineNumber = 0, total = 0, m;
+
+    while (fgets(line, sizeof(line), stdin) != NULL) {
+        char name;
+        double duty, speed;
+
+        ++lineNumber;
+        if ((line[0] == '#') || (strspn(line, " \t\r\n") == strlen(line))) {
+            continue;
+        }
+        if ((sscanf(line, " %c , %lf , %lf", &name, &duty, &speed) != 3) ||
+            (strchr("LlRr", name) == NULL) || (duty < 0) || (duty > 100) || (speed < 0)) {
+            fprintf(stderr, "line %d: expected L|R,duty,speed: %s", lineNumber, line);
+            return 1;
+        }
+        m = ((name == 'L') || (name == 'l')) ? 0 : 1;
+        if (samples[m].count == POINTS) {
+            fprintf(stderr, "line %d: more than %d points for motor %c\n",
+                    lineNumber, POINTS, motorNames[m]);
+            return 1;
+        }
+        samples[m].duty[samples[m].count] = duty;
+        samples[m].speed[samples[m].count] = speed;
+        ++samples[m].count;
+        if ((speed == 0) && (duty > samples[m].stalledDuty)) {
+            samples[m].stalledDuty = duty;
+        }
+        ++total;
+    }
+
+    if (total == 0) {
+        // No data: both motors on the same curve, the firmware maps duties 1:1
+        for (m = 0; m < MOTORS; ++m) {
+            curves[m].slope = 1.0;
+            curves[m].deadband = 0.0;
+            curves[m].rms = 0.0;
+        }
+        reference = 1.0;
+    }
+    else {
+        for (m = 0; m < MOTORS; ++m) {
+            if (!fitCurve(&samples[m], &curves[m])) {
+                fprintf(stderr, "motor %c: need %d moving points at different duties\n",
+                        motorNames[m], MIN_POINTS);
+                return 1;
+            }
+            fprintf(stderr, "motor %c: %d points, slope %.3f [mm/s per %%], deadband %.1f [%%],"
+                    " rms %.1f [mm/s]\n", motorNames[m], samples[m].count, curves[m].slope,
+                    curves[m].deadband, curves[m].rms);
+        }
+        // Slower motor at DUTY_TOP sets the top of the commanded range
+        reference = fmin(curves[0].slope * (DUTY_TOP - curves[0].deadband),
+                         curves[1].slope * (DUTY_TOP - curves[1].deadband)) / DUTY_TOP;
+        if (reference <= 0) {
+            fprintf(stderr, "a deadband reaches %d%%, nothing to calibrate\n", DUTY_TOP);
+            return 1;
+        }
+        fprintf(stderr, "reference %.3f [mm/s per %%]: commanded %d%% = %.0f [mm/s]\n",
+                reference, DUTY_TOP, reference * DUTY_TOP);
+    }
+
+    printf("/*\n"
+           " *************************************************************************************\n"
+           " * MOTOR CALIBRATION\n"
+           " *\n"
+           " * GENERATED BY tools/motor_cal.c - DO NOT EDIT\n"
+           " *\n"
+           " * Per motor: speed [mm/s] = slope * (duty - deadband) above the deadband.\n"
+           " * A commanded duty c stands for REFERENCE * c [mm/s] on both wheels, the\n"
+           " *  firmware drives each motor at deadband + c * REFERENCE / slope.\n"
+           " * Calibrated, REFERENCE is also MM_PER_SEC_PER_DUTY (robot_profile.h).\n");
+    if (total == 0) {
+        printf(" * Uncalibrated: no measurements, commanded duty = motor duty.\n");
+    }
+    else {
+        printf(" * Fit from %d measurements, rms %.1f (L) / %.1f (R) [mm/s].\n",
+               total, curves[0].rms, curves[1].rms);
+    }
+    printf(" *************************************************************************************\n"
+           " */\n");
+    printf("#ifndef MOTOR_CALIBRATION_H\n#define MOTOR_CALIBRATION_H\n\n");
+    printf("#define MOTOR_CAL_VALID      %d\n", total > 0);
+    printf("#define MOTOR_CAL_REFERENCE  %.4ff //[mm/s per %%] of a commanded duty\n\n",
+           reference);
+    for (m = 0; m < MOTORS; ++m) {
+        printf("#define MOTOR_CAL_SLOPE_%c    %.4ff //[mm/s per %%]\n", motorNames[m],
+               curves[m].slope);
+        printf("#define MOTOR_CAL_DEADBAND_%c %.2ff   //[%%]\n", motorNames[m],
+               curves[m].deadband);
+    }
+    printf("\n#endif\n");
+    return 0;
+}
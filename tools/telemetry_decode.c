@@ -0,0 +1,264 @@
+/*
+ *************************************************************************************
+ * ECE 4437
+ * TEAM 5: DANK ERRORS
+ *
+ * TELEMETRY DECODER AND CODEC BENCHMARK
+ *
+ * Host program, build from the repo root:
+ *  gcc -O2 -I. -o telemetry_decode tools/telemetry_decode.c
+ *
+ * Decode a capture of UART1 (TELEMETRY_COMPRESSED = 1):
+ *  ./telemetry_decode < capture.bin
+ *      text from UARTprintf() is passed through, each frame becomes one line
+ *          "<CHANNEL>: <value>, <value>, ..." like the text mode prints it
+ *
+ * Benchmark the codec:
+ *  ./telemetry_decode -b [samples]
+ *
+ * Regression test, exits 1 on failure (add -fsanitize=address to catch overruns):
+ *  ./telemetry_decode -t
+ *************************************************************************************
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "telemetry_codec.h"
+
+/*
+ *************************************************************************************
+ * DEFINING CONSTANTS
+ *************************************************************************************
+ */
+#define READ_SIZE           4096
+#define UART_BYTES_PER_SEC  11520   //115200 baud, 10 bits per byte
+#define BENCH_FRAME         20      //samples per frame, same as BUFFER_SIZE
+#define BENCH_DEFAULT       10000000
+
+// Same order as CHANNEL_* in telemetry_codec.h
+static const char *channelNames[CHANNELS] = {
+    "ERROR", "RIGHT", "FRONT", "PID", "BRANCH",
+    "DUTY_LEFT", "DUTY_RIGHT", "DIRECTION", "LIGHT",
+};
+
+/*
+ *************************************************************************************
+ * DECODE A CAPTURE
+ *************************************************************************************
+ */
+    /*
+     *********************************************************************************
+     *  Writes text and decoded frames to out, returns the number of good frames.
+     *  data[] holds at most one unfinished frame (< CODEC_FRAME_MAX bytes) between
+     *      reads, each read fills only the space left after it.
+     *********************************************************************************
+     */
+static uint32_t decodeStream(FILE *in, FILE *out) {
+    static uint8_t data[READ_SIZE + CODEC_FRAME_MAX];
+    int32_t values[CODEC_MAX_SAMPLES];
+    uint32_t have = 0, pos, count, n;
+    uint32_t frames = 0, rejected = 0;
+    size_t got;
+    uint8_t channel;
+    int used;
+
+    while ((got = fread(&data[have], 1, sizeof(data) - have, in)) > 0) {
+        have += (uint32_t)got;
+        pos = 0;
+        while (pos < have) {
+            if (data[pos] != CODEC_SYNC) {
+                // Plain text from UARTprintf()
+                fputc(data[pos], out);
+                ++pos;
+                continue;
+            }
+            used = codecDecode(&data[pos], have - pos, &channel, values, &count);
+            if (used == 0) {
+                break; //frame continues in the next read
+            }
+            if (used < 0) {
+                ++rejected;
+                ++pos;
+                continue;
+            }
+            if (channel < CHANNELS) {
+                fprintf(out, "%s:", channelNames[channel]);
+            }
+            else {
+                fprintf(out, "ch %u:", channel);
+            }
+            for (n = 0; n < count; ++n) {
+                fprintf(out, " %d,", values[n]);
+            }
+            fprintf(out, "\n");
+            ++frames;
+            pos += (uint32_t)used;
+        }
+        // Keep the unfinished frame for the next read
+        memmove(data, &data[pos], have - pos);
+        have -= pos;
+    }
+    fprintf(stderr, "%u frames, %u bad sync/checksum\n", frames, rejected);
+    return frames;
+}
+
+/*
+ *************************************************************************************
+ * REGRESSION TEST
+ *************************************************************************************
+ */
+    /*
+     *********************************************************************************
+     *  Text, then a SYNC whose header claims a 255 byte payload, then more text
+     *      than one read. The decoder used to wait for the whole "frame", keep more
+     *      than CODEC_FRAME_MAX bytes and read past the end of data[].
+     *  A good frame at the end must still decode after the resync.
+     *********************************************************************************
+     */
+static int regressionTest(void) {
+    static const uint8_t badHeader[] = {CODEC_SYNC, 0x01, 0x01, 0xFF};
+    FILE *in = tmpfile();
+    FILE *out = tmpfile();
+    CodecFrame frame;
+    uint32_t n, frames;
+
+    if ((in == NULL) || (out == NULL)) {
+        fprintf(stderr, "tmpfile failed\n");
+        return 1;
+    }
+    for (n = 0; n < 3840; ++n) {
+        fputc('a', in);
+    }
+    fwrite(badHeader, 1, sizeof(badHeader), in);
+    for (n = 0; n < 252; ++n) {
+        fputc('b', in);
+    }
+    for (n = 0; n < 8000; ++n) {
+        fputc('c', in);
+    }
+    codecBegin(&frame, CHANNEL_ERROR);
+    for (n = 0; n < CODEC_MAX_SAMPLES; ++n) {
+        codecPut(&frame, (int32_t)(n * 1000));
+    }
+    fwrite(frame.bytes, 1, codecEnd(&frame), in);
+    rewind(in);
+
+    frames = decodeStream(in, out);
+    fclose(in);
+    fclose(out);
+    if (frames != 1) {
+        fprintf(stderr, "FAIL: %u frames decoded after the bad header, expected 1\n", frames);
+        return 1;
+    }
+    printf("PASS\n");
+    return 0;
+}
+
+/*
+ *************************************************************************************
+ * BENCHMARK
+ *************************************************************************************
+ */
+static double seconds(void) {
+    struct timespec now;
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return now.tv_sec + now.tv_nsec * 1e-9;
+}
+
+    /*
+     *********************************************************************************
+     *  Encodes and decodes a random walk that looks like |right - target|:
+     *      small steps around a few hundred ADC codes.
+     *
+     *  Reports codec speed on this host and what fits in 115200 baud, against
+     *      the "%X, " text the firmware prints without compression.
+     *********************************************************************************
+     */
+static int benchmark(uint32_t samples) {
+    int32_t *input = malloc(samples * sizeof(int32_t));
+    uint8_t *stream = malloc((samples / BENCH_FRAME + 1) * CODEC_FRAME_MAX);
+    int32_t values[CODEC_MAX_SAMPLES];
+    uint32_t n, count, streamLength = 0, decoded = 0, textBytes = 0;
+    int32_t value = 300;
+    CodecFrame frame;
+    uint8_t channel;
+    double start, encodeTime, decodeTime;
+    char text[16];
+    int used;
+
+    if ((input == NULL) || (stream == NULL)) {
+        fprintf(stderr, "out of memory\n");
+        return 1;
+    }
+
+    srand(4437);
+    for (n = 0; n < samples; ++n) {
+        value += (rand() % 31) - 15;
+        if (value < 0) {
+            value = -value;
+        }
+        input[n] = value;
+        textBytes += (uint32_t)snprintf(text, sizeof(text), "%X, ", value);
+    }
+
+    // Encode
+    start = seconds();
+    for (n = 0; n < samples; n += BENCH_FRAME) {
+        uint32_t k;
+
+        codecBegin(&frame, 0);
+        for (k = n; (k < n + BENCH_FRAME) && (k < samples); ++k) {
+            codecPut(&frame, input[k]);
+        }
+        streamLength += codecEnd(&frame);
+        memcpy(&stream[streamLength - frame.length], frame.bytes, frame.length);
+    }
+    encodeTime = seconds() - start;
+
+    // Decode and check
+    start = seconds();
+    for (n = 0; n < streamLength; n += (uint32_t)used) {
+        used = codecDecode(&stream[n], streamLength - n, &channel, values, &count);
+        if (used <= 0) {
+            fprintf(stderr, "decode failed at byte %u\n", n);
+            return 1;
+        }
+        if (memcmp(values, &input[decoded], count * sizeof(int32_t)) != 0) {
+            fprintf(stderr, "mismatch in frame at byte %u\n", n);
+            return 1;
+        }
+        decoded += count;
+    }
+    decodeTime = seconds() - start;
+
+    printf("samples          %u (%u per frame)\n", samples, BENCH_FRAME);
+    printf("encode           %.1f Msamples/s\n", samples / encodeTime / 1e6);
+    printf("decode           %.1f Msamples/s\n", decoded / decodeTime / 1e6);
+    printf("text \"%%X, \"      %.2f bytes/sample, %.0f samples/s at 115200 baud\n",
+           (double)textBytes / samples, UART_BYTES_PER_SEC * (double)samples / textBytes);
+    printf("delta + varint   %.2f bytes/sample, %.0f samples/s at 115200 baud\n",
+           (double)streamLength / samples,
+           UART_BYTES_PER_SEC * (double)samples / streamLength);
+
+    free(input);
+    free(stream);
+    return 0;
+}
+
+/*
+ *************************************************************************************
+ * MAIN
+ *************************************************************************************
+ */
+int main(int argc, char **argv) {
+    if ((argc >= 2) && !strcmp(argv[1], "-b")) {
+        return benchmark((argc >= 3) ? (uint32_t)strtoul(argv[2], NULL, 0) : BENCH_DEFAULT);
+    }
+    if ((argc >= 2) && !strcmp(argv[1], "-t")) {
+        return regressionTest();
+    }
+    decodeStream(stdin, stdout);
+    return 0;
+}
@@ -0,0 +1,348 @@
+/*
+ *************************************************************************************
+ * ECE 4437
+ * TEAM 5: DANK ERRORS
+ *
+ * WALL CONTROL (PID, BRANCHES, SPEED PLANNER)
+ *
+ * Wall PID, branch choice and speed planning for PID() and tools/maze_sim.c.
+ * Include robot_profile.h and adc_distance_table.h first.
+ *************************************************************************************
+ */
+#ifndef WALL_CONTROL_H
+#define WALL_CONTROL_H
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <math.h>
+
+/*
+ *************************************************************************************
+ * DEFINING CONSTANTS
+ *************************************************************************************
+ */
+#define TARGET_VALUE        TARGET_ADC
+
+//PID() rate the per-tick terms were tuned at (PID_Clk, 50[ms]): kd and steadyBand / 2
+//  are error changes per tick of this rate, wallPid() and planSpeed() rescale them
+//  to the rate they are called at
+#define PID_TUNED_HZ        20
+
+//front sensor thresholds used by selectBranch()
+#define FRONT_UTURN         FRONT_UTURN_ADC
+#define FRONT_CLEAR         FRONT_CLEAR_ADC
+#define FRONT_SHARP         FRONT_SHARP_ADC
+#define FRONT_STRAIGHT      FRONT_STRAIGHT_ADC
+#define FRONT_SPECIAL       FRONT_SPECIAL_ADC
+
+//PROFILE_FINAL decides on the same codes as the raced source
+#if (ROBOT_PROFILE == PROFILE_FINAL) && \
+    ((TARGET_VALUE != 2000) || (FRONT_UTURN != 2000) || (FRONT_CLEAR != 1000) || \
+     (FRONT_SHARP != 1400) || (FRONT_STRAIGHT != 1800) || (FRONT_SPECIAL != 1500))
+#error "PROFILE_FINAL thresholds differ from the raced ADC codes"
+#endif
+
+//side sensor thresholds used by corridorMode() (USE_LEFT_SENSOR)
+#define CORRIDOR_ENTER      MM_TO_ADC(CORRIDOR_ENTER_MM)
+#define CORRIDOR_EXIT       MM_TO_ADC(CORRIDOR_EXIT_MM)
+
+//wall PID() follows
+#define WALL_RIGHT          0       //right wall at TARGET_VALUE
+#define WALL_CENTER         1       //both walls, middle of the corridor
+
+//branch PID() took on the last tick
+#define BRANCH_NONE         0       //no branch matched, previous outputs held
+#define BRANCH_UTURN        1
+#define BRANCH_LEFT         2
+#define BRANCH_RIGHT        3
+#define BRANCH_SHARP        4
+#define BRANCH_STRAIGHT     5
+#define BRANCH_SPECIAL      6
+#define BRANCHES            7
+
+//what the motors do on a tick
+#define MOTOR_DRIVE         0       //duties, negative = reverse
+#define MOTOR_BRAKE         1       //windings shorted, fastest stop
+#define MOTOR_COAST         2       //windings open, rolls out
+
+//duties out of branchDuties() are in 1/DUTY_ONE [%] (robot_profile.h)
+#define DUTY_MAX            (99 * DUTY_ONE) //PWMPulseWidthSet() needs a compare below load
+
+typedef struct {
+    float kp;               //gains at nominal speed
+    float kd;
+    float kpFast;           //gains at maxPercent, interpolated in between
+    float kdFast;
+    float maxPercent;       //cruise duties scaled up to this [% of the profile duty]
+    float minPercent;       //and down to this close to a wall
+    int clearMm;            //maxPercent with this much room ahead
+    int brakeMm;            //100% here
+    int slowMm;             //minPercent here and closer
+    int steadyBand;         //boost only while |error| is inside this [ADC code]
+    float rampUp;           //[% per second], slowing down is immediate
+} SpeedConfig;
+
+// Profile values, the simulator copies this and overrides fields to tune
+#define SPEED_CONFIG { PID_KP, PID_KD, PID_KP_FAST, PID_KD_FAST, \
+                       SPEED_MAX_PERCENT, SPEED_MIN_PERCENT, SPEED_CLEAR_MM, \
+                       SPEED_BRAKE_MM, SPEED_SLOW_MM, SPEED_STEADY_BAND, SPEED_RAMP_UP }
+
+//speed zones, course markers switch between them (MARKER_* in line_sensor.h)
+#define ZONE_NORMAL         0       //SPEED_CONFIG
+#define ZONE_FAST           1       //boost up to ZONE_FAST_PERCENT, gains scheduled to it
+#define ZONE_SLOW           2       //no boost, nominal gains
+#define ZONES               3
+#define ZONE_SPEED_CONFIGS { SPEED_CONFIG, \
+    { PID_KP, PID_KD, PID_KP_ZONE, PID_KD_ZONE, ZONE_FAST_PERCENT, SPEED_MIN_PERCENT, \
+      SPEED_CLEAR_MM, SPEED_BRAKE_MM, SPEED_SLOW_MM, SPEED_STEADY_BAND, SPEED_RAMP_UP }, \
+    { PID_KP, PID_KD, PID_KP, PID_KD, 100.0f, SPEED_MIN_PERCENT, \
+      SPEED_CLEAR_MM, SPEED_BRAKE_MM, SPEED_SLOW_MM, SPEED_STEADY_BAND, SPEED_RAMP_UP } }
+
+typedef struct {
+    float percent;          //current speed [% of the profile duties]
+    int lastError;
+} SpeedState;
+
+/*
+ *************************************************************************************
+ * PID
+ *************************************************************************************
+ */
+    /*
+     *********************************************************************************
+     *  pid = P + I + D on error = right ADC - TARGET_VALUE
+     *      P: error * kp, truncated like the original (error / 20)
+     *      I: error / 10000 (this tick only, the original never accumulated it,
+     *          so it does not depend on the rate)
+     *      D: (error - last error) * kd, the original (3 / 2) was 1 in integer math
+     *          kd is per PID_TUNED_HZ tick: at a faster rate the error changes less
+     *              per tick, the difference is scaled back up by 1 / (dt * PID_TUNED_HZ)
+     *      dt = seconds between calls.
+     *********************************************************************************
+     */
+static inline float wallPid(int error, int lastError, float kp, float kd, float dt) {
+    return truncf(error * kp) + (error / 10000.0f)
+           + (error - lastError) * kd / (dt * PID_TUNED_HZ);
+}
+
+/*
+ *************************************************************************************
+ * CORRIDOR CENTERING
+ *************************************************************************************
+ */
+    /*
+     *********************************************************************************
+     *  WALL_CENTER once both side sensors see a wall closer than CORRIDOR_ENTER_MM,
+     *      back to WALL_RIGHT when either one reads past CORRIDOR_EXIT_MM (an
+     *          opening). Values are ADC codes, larger = closer.
+     *********************************************************************************
+     */
+static inline int corridorMode(int mode, int LeftValue, int RightValue) {
+    if (mode == WALL_CENTER) {
+        return ((LeftValue < CORRIDOR_EXIT) || (RightValue < CORRIDOR_EXIT)) ?
+               WALL_RIGHT : WALL_CENTER;
+    }
+    return ((LeftValue > CORRIDOR_ENTER) && (RightValue > CORRIDOR_ENTER)) ?
+           WALL_CENTER : WALL_RIGHT;
+}
+
+    /*
+     *********************************************************************************
+     *  The right reading PID() sees while centering: TARGET_VALUE plus half the
+     *      difference between the sensors, zero error in the middle of the
+     *          corridor. Closer to the right wall reads as closer to it, so the
+     *              gains and branches of right wall following work unchanged.
+     *********************************************************************************
+     */
+static inline int centeredRightValue(int LeftValue, int RightValue) {
+    int value = TARGET_VALUE + (RightValue - LeftValue) / 2;
+
+    return (value < 0) ? 0 : ((value > 4095) ? 4095 : value);
+}
+
+/*
+ *************************************************************************************
+ * BRANCHES
+ *************************************************************************************
+ */
+    /*
+     *********************************************************************************
+     * Picks PID()'s branch, first match wins. FrontValue is an ADC code
+     *  (larger = closer).
+     *********************************************************************************
+     */
+static inline int selectBranch(float pidRight, int FrontValue) {
+    // Check if dead end & U-Turn
+    if ((pidRight < PID_UTURN_MAX) && (FrontValue > FRONT_UTURN)) {
+        return BRANCH_UTURN;
+    }
+    // Turn Left
+    if ((pidRight > PID_LEFT_MIN) && (FrontValue < FRONT_CLEAR)) {
+        return BRANCH_LEFT;
+    }
+    // Turn Right
+    if ((pidRight > PID_RIGHT_MIN) && (pidRight < PID_RIGHT_MAX) && (FrontValue < FRONT_CLEAR)) {
+        return BRANCH_RIGHT;
+    }
+    // Sharp Right (used when the robot encounters an intersection)
+    if ((pidRight < PID_SHARP_MAX) && (FrontValue < FRONT_SHARP)) {
+        return BRANCH_SHARP;
+    }
+    // Go straight
+    if ((pidRight > -PID_STRAIGHT_BAND) && (pidRight < PID_STRAIGHT_BAND) &&
+        (FrontValue < FRONT_STRAIGHT)) {
+        return BRANCH_STRAIGHT;
+    }
+    // Special straight (used to prevent robot from hitting wall during sharp right turn)
+    if ((pidRight > PID_SPECIAL_MIN) && (pidRight < 0) &&
+        (FrontValue > FRONT_CLEAR) && (FrontValue < FRONT_SPECIAL)) {
+        return BRANCH_SPECIAL;
+    }
+    return BRANCH_NONE;
+}
+
+    /*
+     *********************************************************************************
+     *  Signed duties [1/DUTY_ONE %] of a branch, negative = wheel reversed.
+     *      Cruise branches are scaled by the planner's percent, the U-turn and
+     *          the sharp right are maneuvers and keep their profile duties.
+     *      Profile duties are whole [%], only the scaling makes use of DUTY_ONE.
+     *********************************************************************************
+     */
+static inline int scaleDuty(int duty, float percent) {
+    int scaled = (int)(duty * DUTY_ONE * percent / 100.0f + 0.5f);
+
+    return (scaled > DUTY_MAX) ? DUTY_MAX : scaled;
+}
+
+static inline void branchDuties(int branch, float percent, int *left, int *right) {
+    switch (branch) {
+    case BRANCH_UTURN:
+        *left = -DUTY_UTURN * DUTY_ONE; //left wheel is reversed
+        *right = DUTY_UTURN * DUTY_ONE;
+        break;
+    case BRANCH_LEFT:
+        *left = scaleDuty(DUTY_LEFT_L, percent); //left slow
+        *right = scaleDuty(DUTY_LEFT_R, percent);
+        break;
+    case BRANCH_RIGHT:
+        *left = scaleDuty(DUTY_RIGHT_L, percent);
+        *right = scaleDuty(DUTY_RIGHT_R, percent); //right slow
+        break;
+    case BRANCH_SHARP:
+        *left = DUTY_SHARP_L * DUTY_ONE;
+        *right = DUTY_SHARP_R * DUTY_ONE; //right slow
+        break;
+    case BRANCH_STRAIGHT:
+        *left = scaleDuty(DUTY_STRAIGHT, percent);
+        *right = scaleDuty(DUTY_STRAIGHT, percent);
+        break;
+    case BRANCH_SPECIAL:
+        *left = scaleDuty(DUTY_SPECIAL, percent);
+        *right = scaleDuty(DUTY_SPECIAL, percent);
+        break;
+    }
+}
+
+    /*
+     *********************************************************************************
+     *  A wheel driving forward is stopped before it reverses (the U-turn):
+     *      both wheels brake for brakeTicks ticks, then the new duties start
+     *          from standstill, the same every time. *stopTicks counts down the
+     *              stop, last* are the duties commanded on the previous tick.
+     *  The duties are not touched: keep commanding them through the stop, so the
+     *      tick after it drives them even when no branch matches by then.
+     *  Returns MOTOR_BRAKE while stopping, else MOTOR_DRIVE.
+     *********************************************************************************
+     */
+static inline int stopBeforeReverse(int left, int right, int lastLeft, int lastRight,
+                                    int brakeTicks, int *stopTicks) {
+    if ((*stopTicks == 0) &&
+        (((lastLeft > 0) && (left < 0)) || ((lastRight > 0) && (right < 0)))) {
+        *stopTicks = brakeTicks;
+    }
+    if (*stopTicks > 0) {
+        --*stopTicks;
+        return MOTOR_BRAKE;
+    }
+    return MOTOR_DRIVE;
+}
+
+/*
+ *************************************************************************************
+ * SPEED PLANNER AND GAIN SCHEDULE
+ *************************************************************************************
+ */
+    /*
+     *********************************************************************************
+     *  Target speed from the room ahead:
+     *      clearMm and beyond    -> maxPercent
+     *      brakeMm .. clearMm    -> 100% .. maxPercent
+     *      slowMm .. brakeMm     -> minPercent .. 100%
+     *
+     *  Above 100% only while the last branch was a straight and the error is
+     *      small and steady, anything else drops back to 100% at once.
+     *
+     *  Speeding up is limited to rampUp per second, slowing down is not.
+     *      dt = seconds between calls.
+     *********************************************************************************
+     */
+static inline float planSpeed(const SpeedConfig *config, SpeedState *state,
+                              int frontMm, int error, int lastBranch, float dt) {
+    float target;
+
+    if (frontMm >= config->clearMm) {
+        target = config->maxPercent;
+    }
+    else if (frontMm > config->brakeMm) {
+        target = 100.0f + (config->maxPercent - 100.0f) *
+                 (frontMm - config->brakeMm) / (config->clearMm - config->brakeMm);
+    }
+    else if (frontMm > config->slowMm) {
+        target = config->minPercent + (100.0f - config->minPercent) *
+                 (frontMm - config->slowMm) / (config->brakeMm - config->slowMm);
+    }
+    else {
+        target = config->minPercent;
+    }
+
+    if ((target > 100.0f) &&
+        (((lastBranch != BRANCH_STRAIGHT) && (lastBranch != BRANCH_SPECIAL)) ||
+         (abs(error) > config->steadyBand) ||
+         (abs(error - state->lastError) > (config->steadyBand / 2) * dt * PID_TUNED_HZ))) {
+        target = 100.0f;
+    }
+    state->lastError = error;
+
+    if (target > state->percent + config->rampUp * dt) {
+        state->percent += config->rampUp * dt;
+    }
+    else {
+        state->percent = target;
+    }
+    return state->percent;
+}
+
+    /*
+     *********************************************************************************
+     *  Faster means the error changes more per tick: kd is interpolated from
+     *      kd at 100% to kdFast at maxPercent (kp likewise) so the correction
+     *          per [mm] travelled stays about the same. Nominal gains at or
+     *              below 100%.
+     *********************************************************************************
+     */
+static inline void scheduleGains(const SpeedConfig *config, float percent,
+                                 float *kp, float *kd) {
+    float t = 0.0f;
+
+    if ((config->maxPercent > 100.0f) && (percent > 100.0f)) {
+        t = (percent - 100.0f) / (config->maxPercent - 100.0f);
+        if (t > 1.0f) {
+            t = 1.0f;
+        }
+    }
+    *kp = config->kp + (config->kpFast - config->kp) * t;
+    *kd = config->kd + (config->kdFast - config->kd) * t;
+}
+
+#endif
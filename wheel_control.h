@@ -0,0 +1,112 @@
+/*
+ *************************************************************************************
+ * ECE 4437
+ * TEAM 5: DANK ERRORS
+ *
+ * WHEEL CONTROL (ENCODER SPEED, INNER SPEED LOOP)
+ *
+ * Wheel speed from encoder counts and the PI loop that holds it (USE_QEI).
+ * Include robot_profile.h first.
+ *************************************************************************************
+ */
+#ifndef WHEEL_CONTROL_H
+#define WHEEL_CONTROL_H
+
+#include <stdint.h>
+#include <math.h>
+
+/*
+ *************************************************************************************
+ * DEFINING CONSTANTS
+ *************************************************************************************
+ */
+#define WHEEL_LOOP_HZ       200     //inner loop rate, QEI velocity timer
+#define WHEEL_SPEED_ALPHA   0.5f    //low pass on the count difference, 1 = none
+#define WHEEL_MM_PER_COUNT  ((float)M_PI * WHEEL_DIAMETER_MM / QEI_COUNTS_PER_REV)
+
+typedef struct {
+    float kp;               //[% per mm/s]
+    float ki;               //[% per mm]
+    float ff;               //feed-forward [% per mm/s], the open loop duty
+    float limit;            //|duty| [%]
+    float alpha;            //speed low pass
+} WheelConfig;
+
+// Profile values, the feed-forward is the same speed model as the estimator
+#define WHEEL_CONFIG { WHEEL_KP, WHEEL_KI, 1.0f / MM_PER_SEC_PER_DUTY, 99.0f, \
+                       WHEEL_SPEED_ALPHA }
+
+typedef struct {
+    int32_t lastCount;      //encoder position at the previous update
+    float speed;            //[mm/s], filtered, negative = backward
+    float integral;         //speed error integral [mm]
+    float distance;         //[mm] travelled since the reset, odometry
+} WheelState;
+
+/*
+ *************************************************************************************
+ * SPEED ESTIMATE
+ *************************************************************************************
+ */
+static inline void resetWheel(WheelState *wheel, int32_t count) {
+    wheel->lastCount = count;
+    wheel->speed = 0.0f;
+    wheel->integral = 0.0f;
+    wheel->distance = 0.0f;
+}
+
+    /*
+     *********************************************************************************
+     *  Counts since the last update / dt, low passed. The difference is taken
+     *      in uint32_t so a position that wraps still gives the right delta.
+     *********************************************************************************
+     */
+static inline float updateWheelSpeed(const WheelConfig *config, WheelState *wheel,
+                                     int32_t count, float dt) {
+    int32_t delta = (int32_t)((uint32_t)count - (uint32_t)wheel->lastCount);
+    float travelled = delta * WHEEL_MM_PER_COUNT;
+
+    wheel->lastCount = count;
+    wheel->distance += travelled;
+    wheel->speed += config->alpha * (travelled / dt - wheel->speed);
+    return wheel->speed;
+}
+
+/*
+ *************************************************************************************
+ * SPEED LOOP
+ *************************************************************************************
+ */
+    /*
+     *********************************************************************************
+     *  duty [%] = ff * target + kp * error + ki * integral, error in [mm/s].
+     *      The feed-forward is what the robot drove open loop, the PI part only
+     *          makes up for battery sag and motor mismatch.
+     *      The integral stops while the duty is at the limit, and is cleared on
+     *          a zero target (brakes and stops before a reversal).
+     *********************************************************************************
+     */
+static inline float wheelDuty(const WheelConfig *config, WheelState *wheel, float target,
+                              float dt) {
+    float error, duty;
+
+    if (target == 0.0f) {
+        wheel->integral = 0.0f;
+        return 0.0f;
+    }
+    error = target - wheel->speed;
+    duty = config->ff * target + config->kp * error +
+           config->ki * (wheel->integral + error * dt);
+    if (duty > config->limit) {
+        duty = config->limit;
+    }
+    else if (duty < -config->limit) {
+        duty = -config->limit;
+    }
+    else {
+        wheel->integral += error * dt;
+    }
+    return duty;
+}
+
+#endif